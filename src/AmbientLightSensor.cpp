@@ -11,9 +11,9 @@ AmbientLightSensor::AmbientLightSensor(const Parameters& parameters)
     , m_v_measurement_als_1(parameters.v_latest_measurement_als1)
     , m_v_measurement_als_2(parameters.v_latest_measurement_als2)
     , m_v_lux_target(parameters.v_lux_target)
-    , m_v_motor_command(parameters.v_motor_command)
+    , m_motors(parameters.motors)
     , m_s_control_auto(parameters.s_control_auto)
-    , m_s_http_notify(parameters.s_http_notify)
+    , m_notifier(parameters.notifier)
     , m_red(parameters.red)
 {
     if (xTaskCreate(TASK_KONDOM(AmbientLightSensor, Task),
@@ -39,7 +39,6 @@ void AmbientLightSensor::Task()
         }
         StopMotorAdjusting();
         StopMeasuring();
-        m_s_http_notify->Give();
         xTaskDelayUntil(&m_previous_measurement_tick, m_passive_measurement_period_ticks);
     }
 }
@@ -91,6 +90,7 @@ bool AmbientLightSensor::Measure()
             m_lux_average = m_measurement_als2.lux;
         }
     }
+    m_notifier->Publish(Notifier::bLUX);
     return true;
 }
 
@@ -107,9 +107,9 @@ bool AmbientLightSensor::OnTarget()
     const float lux_current_difference = (lux_target - m_lux_average) / lux_target;
     static constexpr float MARGIN = 0.1;
     if (lux_current_difference < -MARGIN) {
-        m_v_motor_command->Overwrite(Motor::CLOSE);
+        CommandMotors(Motor::CLOSE);
     } else if (lux_current_difference > MARGIN) {
-        m_v_motor_command->Overwrite(Motor::OPEN);
+        CommandMotors(Motor::OPEN);
     } else {
         if (m_commanding_motor) {
             Logger::Log("Lux target reached: {} lux ~= Measured average: {} lux", lux_target, m_lux_average);
@@ -126,13 +126,31 @@ void AmbientLightSensor::StopMeasuring()
     m_als2.PowerDown();
 }
 
+void AmbientLightSensor::CommandMotors(const Motor::Command command)
+{
+    for (size_t channel = 0; channel < m_motors.size(); ++channel) {
+        // a channel calibrating after a failure is left to finish
+        if (m_motors.at(channel)->CurrentCommand() != Motor::CALIBRATE) {
+            m_motor_sequences.at(channel) = m_motors.at(channel)->Post(command, m_task_handle);
+        }
+    }
+}
+
 bool AmbientLightSensor::MotorAdjusting() const
 {
-    Motor::Command command;
-    if (!m_v_motor_command->Peek(&command, 0)) {
-        return false;
+    for (size_t channel = 0; channel < m_motors.size(); ++channel) {
+        if (MotorAdjusting(channel)) {
+            return true;
+        }
     }
-    return (command == Motor::OPEN || command == Motor::CLOSE);
+    return false;
+}
+
+bool AmbientLightSensor::MotorAdjusting(const size_t channel) const
+{
+    // anyone else's command replaces ours and so completes it as well
+    const Motor::Sequence sequence = m_motor_sequences.at(channel);
+    return sequence != 0 && !m_motors.at(channel)->WaitForCompletion(sequence, 0);
 }
 
 void AmbientLightSensor::StopMotorAdjusting()
@@ -141,8 +159,9 @@ void AmbientLightSensor::StopMotorAdjusting()
     if (!ControlAuto()) {
         return;
     }
-    Motor::Command command;
-    if (m_v_motor_command->Receive(&command, 0) && command != Motor::OPEN && command != Motor::CLOSE) {
-        m_v_motor_command->Append(command, 0);
+    for (size_t channel = 0; channel < m_motors.size(); ++channel) {
+        if (MotorAdjusting(channel)) {
+            m_motor_sequences.at(channel) = m_motors.at(channel)->Post(Motor::STOP, m_task_handle);
+        }
     }
 }
@@ -1,10 +1,14 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+
 #include <FreeRTOS.h>
 #include <task.h>
 
 #include "BH1750.hpp"
 #include "Motor.hpp"
+#include "Notifier.hpp"
 #include "Queue.hpp"
 #include "Semaphore.hpp"
 
@@ -24,9 +28,10 @@ public:
         RTOS::Variable<LuxMeasurement>* v_latest_measurement_als1;
         RTOS::Variable<LuxMeasurement>* v_latest_measurement_als2;
         RTOS::Variable<float>* v_lux_target;
-        RTOS::Variable<Motor::Command>* v_motor_command;
+        /// Moved in unison
+        MotorChannels motors;
         RTOS::Semaphore* s_control_auto;
-        RTOS::Semaphore* s_http_notify;
+        Notifier* notifier;
 
         Indicator* red;
     };
@@ -41,7 +46,11 @@ private:
     bool Measure();
     [[nodiscard]] bool OnTarget();
     void StopMeasuring();
+    /// Posts 'command' to every channel not calibrating
+    void CommandMotors(Motor::Command command);
+    /// True while any channel still carries out a command of ours
     [[nodiscard]] bool MotorAdjusting() const;
+    [[nodiscard]] bool MotorAdjusting(size_t channel) const;
     void StopMotorAdjusting();
     [[nodiscard]] bool ControlAuto() const { return m_s_control_auto->Count() == 1; }
 
@@ -51,9 +60,11 @@ private:
     RTOS::Variable<LuxMeasurement>* m_v_measurement_als_1;
     RTOS::Variable<LuxMeasurement>* m_v_measurement_als_2;
     RTOS::Variable<float>* m_v_lux_target;
-    RTOS::Variable<Motor::Command>* m_v_motor_command;
+    MotorChannels m_motors;
+    /// The last command this task posted to each channel, 0 if none
+    std::array<Motor::Sequence, MOTOR_CHANNELS> m_motor_sequences = {};
     RTOS::Semaphore* m_s_control_auto;
-    RTOS::Semaphore* m_s_http_notify;
+    Notifier* m_notifier;
 
     TaskHandle_t m_task_handle = nullptr;
     TickType_t m_passive_measurement_period_ticks = pdMS_TO_TICKS(10000);
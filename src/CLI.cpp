@@ -10,7 +10,7 @@
 
 CLI::CLI(const Parameters& parameters)
     : m_v_lux_target(parameters.v_lux_target)
-    , m_v_motor_command(parameters.v_motor_command)
+    , m_motors(parameters.motors)
     , m_s_control_auto(parameters.s_control_auto)
     , m_s_auto_hourly(parameters.s_auto_hourly)
     , m_storage(parameters.storage)
@@ -54,6 +54,8 @@ void CLI::ProcessCommand()
         TargetCommand();
     } else if (cmd == "motor") {
         MotorCommand();
+    } else if (cmd == "save") {
+        SaveCommand();
     } else if (cmd == "datetime") {
         DatetimeCommand();
     } else if (cmd == "date") {
@@ -104,6 +106,7 @@ void CLI::HelpCommand()
                     "status - show system status\n"
                     "target - set target lux level\n"
                     "motor - control the motor\n"
+                    "save - write pending settings to flash now\n"
                     "datetime - set system date and time\n\n"
                     "Use 'help [command]' for additional information on each command");
     } else if (cmd == "help") {
@@ -130,8 +133,18 @@ void CLI::HelpCommand()
                     "open - fully opens the curtain\n"
                     "close - fully closes the curtain\n"
                     "0-100 - will move the curtain to specified position, 0%: fully open - 100%: fully closed\n"
+                    "        a tenth of a percent is accepted too, but saved rounded to the percent\n"
+                    "steps - will move the curtain to the given step count from fully open, not saved\n"
+                    "Moving commands go to every curtain, unless prefixed with the channel number and ':'\n"
                     "Example: 'motor auto' will enable automatic static mode\n"
-                    "         'motor 70' will move the curtain to be 70% closed");
+                    "         'motor 70' will move the curtain to be 70% closed\n"
+                    "         'motor 70.5' will move the curtain to be 70.5% closed\n"
+                    "         'motor steps 1200' will move the curtain 1200 steps from fully open\n"
+                    "         'motor 1:calibrate' will calibrate the curtain of channel 1 only");
+    } else if (cmd == "save") {
+        Logger::Log("save - write pending settings to flash now\n"
+                    "Settings changes are normally written a few seconds after the last change;\n"
+                    "use this before cutting power");
     } else if (cmd == "datetime") {
         Logger::Log("datetime - set system date and time\n"
                     "Requires date and time information to set correctly\n"
@@ -150,7 +163,7 @@ void CLI::StatusCommand()
 {
     /// TODO get additional status info from relevant task(s), simple/advanced status display
     Flash::Settings flash_settings {};
-    m_storage->ReadOnlyAccessLocked(portMAX_DELAY, [&](const Flash::Settings& settings) {
+    m_storage->ReadOnlyAccess([&](const Flash::Settings& settings) {
         flash_settings = settings;
     });
     Logger::Log("{}", Storage::StringifySettings(flash_settings));
@@ -168,7 +181,7 @@ void CLI::TargetCommand()
         if (target >= 0 && target <= FLT_MAX && hour >= 0 && hour <= 23) {
             Logger::Log("Lux target for hour {} set to {}", hour, target);
             m_v_lux_target->Overwrite(target);
-            m_storage->WriteAccessAndProgramLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
+            m_storage->WriteAccessLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
                 settings.lux_targets[hour] = target;
             });
         } else {
@@ -176,57 +189,102 @@ void CLI::TargetCommand()
         }
     } else if (target >= 0 && target <= FLT_MAX) {
         m_v_lux_target->Overwrite(target);
-        m_storage->WriteAccessAndProgramLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
+        m_storage->WriteAccessLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
             settings.lux_targets[Flash::Lux::LUX_STATIC] = target;
         });
         Logger::Log("Static lux target set to {}", target);
     }
 }
 
+void CLI::SaveCommand()
+{
+    if (m_storage->Flush()) {
+        Logger::Log("Settings saved");
+    } else {
+        Logger::Log("Error: Settings could not be saved");
+    }
+}
+
 void CLI::MotorCommand()
 {
     std::string motor_cmd;
-    Motor::Command current = Motor::STOP;
-    Motor::Command new_target = Motor::STOP;
-    m_v_motor_command->Peek(&current, 0);
-    if (current != Motor::CALIBRATE) {
-        if (m_input >> motor_cmd) {
-            if (motor_cmd == "manual") {
-                m_s_control_auto->Take(0);
-                m_s_auto_hourly->Take(0);
-                m_storage->WriteAccessAndProgramLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
-                    settings.sys_mode = 0;
-                });
-            } else if (motor_cmd == "auto") {
-                m_s_control_auto->Give();
-                m_storage->WriteAccessAndProgramLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
-                    settings.sys_mode = Flash::bAUTO;
-                });
-            } else if (motor_cmd == "hourly") {
-                m_s_control_auto->Give();
-                m_s_auto_hourly->Give();
-                m_storage->WriteAccessAndProgramLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
-                    settings.sys_mode = Flash::bAUTO_HOURLY | Flash::bAUTO;
-                });
-            } else if (motor_cmd == "calibrate") {
-                m_v_motor_command->Overwrite(Motor::CALIBRATE);
-            } else {
-                new_target = MotorStringToTarget(motor_cmd);
-                if (new_target != static_cast<Motor::Command>(-1)) {
-                    m_s_control_auto->Take(0);
-                    m_v_motor_command->Overwrite(new_target);
-                    m_storage->WriteAccessAndProgramLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
-                        settings.motor_target = new_target;
-                    });
-                } else {
-                    Logger::Log("motor - invalid command, see 'help motor' for additional info");
-                }
-            }
-        } else {
+    if (!(m_input >> motor_cmd)) {
+        Logger::Log("motor - missing motor command, see 'help motor' for additional info");
+        return;
+    }
+    // "<n>:" picks a channel, otherwise the command goes to all of them
+    size_t first = 0;
+    size_t last = m_motors.size();
+    unsigned channel = 0;
+    int consumed = 0;
+    if (sscanf(motor_cmd.c_str(), "%u:%n", &channel, &consumed) == 1 && consumed > 0) {
+        if (channel >= m_motors.size()) {
+            Logger::Log("motor - no channel {}, there are {}", channel, m_motors.size());
+            return;
+        }
+        first = channel;
+        last = channel + 1;
+        motor_cmd.erase(0, consumed);
+        if (motor_cmd.empty() && !(m_input >> motor_cmd)) {
             Logger::Log("motor - missing motor command, see 'help motor' for additional info");
+            return;
+        }
+    }
+    for (size_t i = first; i < last; ++i) {
+        if (m_motors.at(i)->CurrentCommand() == Motor::CALIBRATE) {
+            Logger::Log("Motor {} currently calibrating, command ignored", i);
+            return;
+        }
+    }
+    const auto post = [&](const Motor::Command command) {
+        for (size_t i = first; i < last; ++i) {
+            m_motors.at(i)->Post(command);
+        }
+    };
+
+    if (motor_cmd == "manual") {
+        m_s_control_auto->Take(0);
+        m_s_auto_hourly->Take(0);
+        m_storage->WriteAccessLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
+            settings.sys_mode = 0;
+        });
+    } else if (motor_cmd == "auto") {
+        m_s_control_auto->Give();
+        m_storage->WriteAccessLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
+            settings.sys_mode = Flash::bAUTO;
+        });
+    } else if (motor_cmd == "hourly") {
+        m_s_control_auto->Give();
+        m_s_auto_hourly->Give();
+        m_storage->WriteAccessLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
+            settings.sys_mode = Flash::bAUTO_HOURLY | Flash::bAUTO;
+        });
+    } else if (motor_cmd == "calibrate") {
+        post(Motor::CALIBRATE);
+    } else if (motor_cmd == "steps") {
+        int steps;
+        if (m_input >> steps && 0 <= steps && steps <= Motor::STEPS_MAX) {
+            // a step count means nothing after a recalibration, so it is not saved
+            m_s_control_auto->Take(0);
+            post(Motor::Steps(steps));
+        } else {
+            Logger::Log("motor - invalid step count, see 'help motor' for additional info");
         }
     } else {
-        Logger::Log("Motor currently calibrating, command ignored");
+        const Motor::Command new_target = MotorStringToTarget(motor_cmd);
+        if (new_target != static_cast<Motor::Command>(-1)) {
+            m_s_control_auto->Take(0);
+            post(new_target);
+            m_storage->WriteAccessLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
+                for (size_t i = first; i < last; ++i) {
+                    settings.channels[i].motor_target = static_cast<uint8_t>(new_target <= Motor::CLOSE_COMPLETELY
+                            ? new_target
+                            : (new_target - Motor::PERMILLE + 5) / 10);
+                }
+            });
+        } else {
+            Logger::Log("motor - invalid command, see 'help motor' for additional info");
+        }
     }
 }
 
@@ -243,6 +301,11 @@ Motor::Command CLI::MotorStringToTarget(const std::string& str)
     if (((sscanf(str.c_str(), "%d%c", &num, dummy) == 1)) && (Motor::CLOSE_COMPLETELY >= num && Motor::OPEN_COMPLETELY <= num)) {
         return static_cast<Motor::Command>(num);
     }
+    int tenth;
+    if (sscanf(str.c_str(), "%d.%1d%c", &num, &tenth, dummy) == 2 && 0 <= tenth
+        && Motor::OPEN_COMPLETELY <= num && num * 10 + tenth <= Motor::PERMILLE_MAX) {
+        return Motor::Permille(num * 10 + tenth);
+    }
     return static_cast<Motor::Command>(-1);
 }
 
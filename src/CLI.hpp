@@ -23,7 +23,7 @@ public:
         RTOS::Variable<LuxMeasurement>* v_latest_measurement_als1;
         RTOS::Variable<LuxMeasurement>* v_latest_measurement_als2;
         RTOS::Variable<float>* v_lux_target;
-        RTOS::Variable<Motor::Command>* v_motor_command;
+        MotorChannels motors;
         RTOS::Semaphore* s_control_auto;
         RTOS::Semaphore* s_auto_hourly;
         Storage* storage;
@@ -42,6 +42,7 @@ private:
     void StatusCommand();
     void TargetCommand();
     void MotorCommand();
+    void SaveCommand();
     void DatetimeCommand();
     void DateCommand();
     void YearCommand();
@@ -54,7 +55,7 @@ private:
     void SecCommand();
 
     RTOS::Variable<float>* m_v_lux_target;
-    RTOS::Variable<Motor::Command>* m_v_motor_command;
+    MotorChannels m_motors;
     RTOS::Semaphore* m_s_control_auto;
     RTOS::Semaphore* m_s_auto_hourly;
     Storage* m_storage;
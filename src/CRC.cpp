@@ -0,0 +1,80 @@
+#include "CRC.hpp"
+
+#include <array>
+
+#include <FreeRTOS.h>
+#include <hardware/dma.h>
+#include <task.h>
+
+namespace {
+constexpr uint16_t POLYNOMIAL = 0x1021;
+
+constexpr std::array<uint16_t, 256> MakeCCITTTable()
+{
+    std::array<uint16_t, 256> table {};
+    for (size_t byte = 0; byte < table.size(); ++byte) {
+        uint16_t crc = byte << 8;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = crc & 0x8000 ? (crc << 1) ^ POLYNOMIAL : crc << 1;
+        }
+        table[byte] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint16_t, 256> CCITT_TABLE = MakeCCITTTable();
+static_assert(CCITT_TABLE[1] == POLYNOMIAL && CCITT_TABLE[255] == 0x1EF0);
+} // namespace
+
+bool CRC16::s_sniffer_busy = false;
+
+uint16_t CRC16::Compute(const uint8_t* buf, size_t length, uint16_t crc)
+{
+    while (length--) {
+        uint8_t x = crc >> 8 ^ *buf++;
+        x ^= x >> 4;
+        crc = (crc << 8) ^ (static_cast<uint16_t>(x << 5) ^ static_cast<uint16_t>(x));
+    }
+    return crc;
+}
+
+uint16_t CRC16::CCITT(const uint8_t* buf, size_t length, uint16_t crc)
+{
+    while (length--) {
+        crc = (crc << 8) ^ CCITT_TABLE[(crc >> 8) ^ *buf++];
+    }
+    return crc;
+}
+
+uint16_t CRC16::CCITTWithDMA(const uint8_t* buf, const size_t length, const uint16_t crc)
+{
+    taskENTER_CRITICAL();
+    const bool busy = s_sniffer_busy;
+    s_sniffer_busy = true;
+    taskEXIT_CRITICAL();
+    if (busy) {
+        return CCITT(buf, length, crc);
+    }
+    const int channel = dma_claim_unused_channel(false);
+    if (channel < 0) {
+        s_sniffer_busy = false;
+        return CCITT(buf, length, crc);
+    }
+
+    static uint8_t sink = 0;
+    dma_channel_config config = dma_channel_get_default_config(channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_sniff_enable(&config, true);
+    dma_sniffer_enable(channel, DMA_SNIFF_CTRL_CALC_VALUE_CRC16, true);
+    dma_sniffer_set_data_accumulator(crc);
+    dma_channel_configure(channel, &config, &sink, buf, length, true);
+    dma_channel_wait_for_finish_blocking(channel);
+    const uint16_t result = dma_sniffer_get_data_accumulator() & 0xFFFF;
+    dma_sniffer_disable();
+    dma_channel_unclaim(channel);
+
+    s_sniffer_busy = false;
+    return result;
+}
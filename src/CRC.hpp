@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// 16-bit CRCs with initial value 0xFFFF, no reflection and no final XOR. Appending the
+/// big-endian CRC to a buffer makes the CRC over the whole thing 0.
+class CRC16 {
+public:
+    static constexpr uint16_t INITIAL = 0xFFFF;
+
+    /// The checksum the settings in flash have always been stored with. It drops the x^12
+    /// term of CRC-CCITT, so it cannot be handed to the DMA sniffer; it stays as it is so
+    /// existing records remain readable. Branch-free shift/xor; a 256 entry table measured
+    /// slower on the host and would be read through XIP on the device.
+    [[nodiscard]] static uint16_t Compute(const uint8_t* buf, size_t length, uint16_t crc = INITIAL);
+
+    /// CRC-16/CCITT-FALSE (polynomial 0x1021), table driven
+    [[nodiscard]] static uint16_t CCITT(const uint8_t* buf, size_t length, uint16_t crc = INITIAL);
+    /// Same result as CCITT(), computed by the DMA sniffer; pays off for large buffers such as
+    /// firmware images. Falls back to CCITT() if no channel is free or the sniffer is in use.
+    [[nodiscard]] static uint16_t CCITTWithDMA(const uint8_t* buf, size_t length, uint16_t crc = INITIAL);
+
+private:
+    static bool s_sniffer_busy;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cassert>
+
+#include <FreeRTOS.h>
+#include <event_groups.h>
+
+namespace RTOS {
+class EventGroup {
+public:
+    using Bits = EventBits_t;
+
+    explicit EventGroup(const char* name)
+        : m_handle(xEventGroupCreate())
+        , m_name(name)
+    {
+        assert(m_handle);
+    }
+
+    ~EventGroup()
+    {
+        if (m_handle != nullptr) {
+            vEventGroupDelete(m_handle);
+        }
+    }
+
+    EventGroup(const EventGroup&) = delete;
+    EventGroup(EventGroup&&) = delete;
+    EventGroup& operator=(const EventGroup&) = delete;
+    EventGroup& operator=(EventGroup&&) = delete;
+
+    Bits Set(const Bits bits) { return xEventGroupSetBits(m_handle, bits); }
+    /// Returns the bits as they were before clearing
+    Bits Clear(const Bits bits) { return xEventGroupClearBits(m_handle, bits); }
+    [[nodiscard]] Bits Get() const { return xEventGroupGetBits(m_handle); }
+
+    /// Returns the set bits out of 'bits' and clears them, or 0 on timeout
+    Bits TakeAny(const Bits bits, const TickType_t wait_time_ticks)
+    {
+        return xEventGroupWaitBits(m_handle, bits, pdTRUE, pdFALSE, wait_time_ticks) & bits;
+    }
+
+    bool SetFromISR(const Bits bits, BaseType_t* higher_priority_task_woken)
+    {
+        return xEventGroupSetBitsFromISR(m_handle, bits, higher_priority_task_woken) == pdPASS;
+    }
+
+    [[nodiscard]] const char* Name() const { return m_name; }
+
+private:
+    EventGroupHandle_t m_handle;
+    const char* m_name;
+};
+} // namespace RTOS
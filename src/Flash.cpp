@@ -1,10 +1,17 @@
 #include "Flash.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 #include <hardware/flash.h>
+#include <hardware/timer.h>
 #include <pico/flash.h>
 
+#include "CRC.hpp"
 #include "Logger.hpp"
 
+extern "C" char __flash_binary_end;
+
 Flash::Flash()
     : m_settings(FactorySettings())
 {
@@ -27,61 +34,282 @@ bool Flash::UpdateFrom(ptrdiff_t settings_address)
         return false;
     }
     auto settings_pointer = FlashPointer(settings_address);
-    if (CRC16(settings_pointer, SETTINGS_LEN) != 0) {
+    if (CRC16::Compute(settings_pointer, SETTINGS_LEN) != 0) {
         Logger::Log("[Flash] Warning: CRC {} failed", settings_address == FLASH_SETTINGS_A ? "A" : "B");
         return false;
     }
-    std::memcpy(&m_settings.lux_targets, settings_pointer, LUX_MAP_LEN);
-    settings_pointer += LUX_MAP_LEN;
-    std::memcpy(&m_settings.sys_mode, settings_pointer, SYSTEM_MODE_LEN);
-    settings_pointer += SYSTEM_MODE_LEN;
-    std::memcpy(&m_settings.motor_target, settings_pointer, MOTOR_TARGET_LEN);
-    settings_pointer += MOTOR_TARGET_LEN;
+    DeserializeFixed(settings_pointer);
 
     Logger::Log("[Flash] Updated from flash {}", settings_address == FLASH_SETTINGS_A ? "A" : "B");
     return true;
 }
 
+void Flash::DeserializeFixed(const uint8_t* payload)
+{
+    std::memcpy(&m_settings.lux_targets, payload, LUX_MAP_LEN);
+    std::memcpy(&m_settings.sys_mode, payload + LUX_MAP_LEN, SYSTEM_MODE_LEN);
+    std::memcpy(&m_settings.channels[0].motor_target, payload + LUX_MAP_LEN + SYSTEM_MODE_LEN, MOTOR_TARGET_LEN);
+    SeedWeeklyTargets(&m_settings);
+}
+
+const uint8_t* Flash::FindField(const uint8_t* payload, const size_t length, const Field tag, const uint16_t value_length)
+{
+    const uint8_t* const end = payload + length;
+    while (payload + sizeof(FieldHeader) <= end) {
+        FieldHeader header;
+        std::memcpy(&header, payload, sizeof(header));
+        const uint8_t* value = payload + sizeof(header);
+        if (value + header.length > end) {
+            return nullptr;
+        }
+        if (header.tag == tag) {
+            const bool usable = header.version == FIELD_VERSION
+                && header.length == value_length
+                && CRC16::Compute(value, header.length) == header.crc;
+            return usable ? value : nullptr;
+        }
+        payload = value + header.length;
+    }
+    return nullptr;
+}
+
+void Flash::DecodeFields(const uint8_t* payload, const size_t length)
+{
+    const auto decode = [&](const Field tag, void* value, const uint16_t value_length) {
+        if (const uint8_t* found = FindField(payload, length, tag, value_length)) {
+            std::memcpy(value, found, value_length);
+            return true;
+        }
+        Logger::Log("[Flash] Warning: Field {} missing or damaged, keeping its previous value", +tag);
+        return false;
+    };
+    decode(fLUX_TARGETS, &m_settings.lux_targets, LUX_MAP_LEN);
+    decode(fSYSTEM_MODE, &m_settings.sys_mode, SYSTEM_MODE_LEN);
+    decode(fMOTOR_TARGET, &m_settings.channels[0].motor_target, MOTOR_TARGET_LEN);
+    std::array<BeltType, 2> belt = { m_settings.channels[0].belt_max, m_settings.channels[0].belt_position };
+    decode(fBELT, belt.data(), sizeof(belt));
+    m_settings.channels[0].belt_max = belt[0];
+    m_settings.channels[0].belt_position = belt[1];
+    std::array<uint8_t, CHANNELS_FIELD_LEN> channels;
+    if (decode(fCHANNELS, channels.data(), channels.size())) {
+        const uint8_t* in = channels.data();
+        for (size_t channel = 1; channel < MAX_MOTOR_CHANNELS; ++channel, in += CHANNEL_FIELD_LEN) {
+            Channel& settings = m_settings.channels[channel];
+            std::memcpy(&settings.motor_target, in, MOTOR_TARGET_LEN);
+            std::memcpy(&settings.belt_max, in + MOTOR_TARGET_LEN, BELT_LEN);
+            std::memcpy(&settings.belt_position, in + MOTOR_TARGET_LEN + BELT_LEN, BELT_LEN);
+        }
+    }
+    decode(fSCHEDULE, &m_settings.schedule, sizeof(m_settings.schedule));
+    if (!decode(fWEEKLY_TARGETS, &m_settings.weekly_targets, sizeof(m_settings.weekly_targets))) {
+        SeedWeeklyTargets(&m_settings);
+    }
+    std::array<uint8_t, CURVE_FIELD_LEN> curve;
+    if (decode(fCURVE, curve.data(), curve.size())) {
+        m_settings.curve_points = std::min<uint8_t>(curve[0], CURVE_CAPACITY);
+        std::memcpy(m_settings.curve, curve.data() + 1, sizeof(m_settings.curve));
+    }
+}
+
+uint8_t* Flash::EncodeField(uint8_t* out, const Field tag, const void* value, const uint16_t length)
+{
+    const FieldHeader header {
+        .tag = tag,
+        .version = FIELD_VERSION,
+        .length = length,
+        .crc = CRC16::Compute(static_cast<const uint8_t*>(value), length),
+    };
+    std::memcpy(out, &header, sizeof(header));
+    std::memcpy(out + sizeof(header), value, length);
+    return out + sizeof(header) + length;
+}
+
+size_t Flash::EncodeFields(uint8_t* payload) const
+{
+    static_assert(sizeof(RecordHeader) + 8 * sizeof(FieldHeader) + LUX_MAP_LEN + SYSTEM_MODE_LEN + MOTOR_TARGET_LEN + 2 * BELT_LEN
+            + sizeof(Settings::schedule) + sizeof(Settings::weekly_targets) + CURVE_FIELD_LEN + CHANNELS_FIELD_LEN
+        <= MAX_RECORD_SIZE);
+    uint8_t* out = payload;
+    out = EncodeField(out, fLUX_TARGETS, m_settings.lux_targets, LUX_MAP_LEN);
+    out = EncodeField(out, fSYSTEM_MODE, &m_settings.sys_mode, SYSTEM_MODE_LEN);
+    out = EncodeField(out, fMOTOR_TARGET, &m_settings.channels[0].motor_target, MOTOR_TARGET_LEN);
+    const std::array<BeltType, 2> belt = { m_settings.channels[0].belt_max, m_settings.channels[0].belt_position };
+    out = EncodeField(out, fBELT, belt.data(), sizeof(belt));
+    out = EncodeField(out, fSCHEDULE, &m_settings.schedule, sizeof(m_settings.schedule));
+    out = EncodeField(out, fWEEKLY_TARGETS, m_settings.weekly_targets, sizeof(m_settings.weekly_targets));
+    std::array<uint8_t, CURVE_FIELD_LEN> curve;
+    curve[0] = m_settings.curve_points;
+    std::memcpy(curve.data() + 1, m_settings.curve, sizeof(m_settings.curve));
+    out = EncodeField(out, fCURVE, curve.data(), curve.size());
+    std::array<uint8_t, CHANNELS_FIELD_LEN> channels;
+    uint8_t* channel_out = channels.data();
+    for (size_t channel = 1; channel < MAX_MOTOR_CHANNELS; ++channel, channel_out += CHANNEL_FIELD_LEN) {
+        const Channel& settings = m_settings.channels[channel];
+        std::memcpy(channel_out, &settings.motor_target, MOTOR_TARGET_LEN);
+        std::memcpy(channel_out + MOTOR_TARGET_LEN, &settings.belt_max, BELT_LEN);
+        std::memcpy(channel_out + MOTOR_TARGET_LEN + BELT_LEN, &settings.belt_position, BELT_LEN);
+    }
+    out = EncodeField(out, fCHANNELS, channels.data(), channels.size());
+    return out - payload;
+}
+
+bool Flash::RecordIsValid(const ptrdiff_t record_address)
+{
+    RecordHeader header;
+    std::memcpy(&header, FlashPointer(record_address), sizeof(header));
+    if (header.magic != RECORD_MAGIC || header.length > MAX_RECORD_SIZE - sizeof(RecordHeader)) {
+        return false;
+    }
+    return CRC16::Compute(FlashPointer(record_address + RECORD_CRC_OFFSET), sizeof(RecordHeader) - RECORD_CRC_OFFSET) == header.crc;
+}
+
+bool Flash::RecordIsIntact(const ptrdiff_t record_address)
+{
+    if (!RecordIsValid(record_address)) {
+        return false;
+    }
+    RecordHeader header;
+    std::memcpy(&header, FlashPointer(record_address), sizeof(header));
+    const uint8_t* field = FlashPointer(record_address) + sizeof(RecordHeader);
+    const uint8_t* const end = field + header.length;
+    while (field + sizeof(FieldHeader) <= end) {
+        FieldHeader field_header;
+        std::memcpy(&field_header, field, sizeof(field_header));
+        const uint8_t* value = field + sizeof(field_header);
+        if (value + field_header.length > end || CRC16::Compute(value, field_header.length) != field_header.crc) {
+            return false;
+        }
+        field = value + field_header.length;
+    }
+    return field == end;
+}
+
+bool Flash::IsErased(const ptrdiff_t flash_address, const size_t length)
+{
+    const uint8_t* pointer = FlashPointer(flash_address);
+    return std::all_of(pointer, pointer + length, [](const uint8_t byte) { return byte == BYTE_EMPTY; });
+}
+
+ptrdiff_t Flash::NextRecordAddress(const ptrdiff_t record_address)
+{
+    const ptrdiff_t next = record_address + FLASH_PAGE_SIZE;
+    return next < LOG_TOP ? next : LOG_BOTTOM;
+}
+
+bool Flash::RecoverFromLog()
+{
+    ptrdiff_t newest_address = -1;
+    RecordHeader newest = {};
+    // the newest record whose fields all check out; the fields a torn or damaged newer one lost come from it
+    ptrdiff_t intact_address = -1;
+    RecordHeader intact = {};
+    size_t valid_records = 0;
+    // Records written before the journal existed may lie above LOG_TOP
+    for (ptrdiff_t address = FLASH_SETTINGS_BOTTOM; address < FLASH_SETTINGS_TOP;) {
+        RecordHeader header;
+        std::memcpy(&header, FlashPointer(address), sizeof(header));
+        if (header.magic != RECORD_MAGIC) {
+            address += FLASH_PAGE_SIZE;
+            continue;
+        }
+        if (!RecordIsValid(address)) {
+            Logger::Log("[Flash] Warning: Skipping corrupted record at [0x{:X}]", address);
+            address += FLASH_PAGE_SIZE;
+            continue;
+        }
+        ++valid_records;
+        if (newest_address < 0 || header.sequence > newest.sequence) {
+            newest_address = address;
+            newest = header;
+        }
+        if ((intact_address < 0 || header.sequence > intact.sequence) && RecordIsIntact(address)) {
+            intact_address = address;
+            intact = header;
+        }
+        address += RecordSize(header.length);
+    }
+    if (newest_address < 0) {
+        return false;
+    }
+
+    if (intact_address >= 0 && intact_address != newest_address) {
+        Logger::Log("[Flash] Warning: Record #{} damaged; fields it lost come from record #{}", newest.sequence, intact.sequence);
+        DecodeFields(FlashPointer(intact_address) + sizeof(RecordHeader), intact.length);
+    }
+    DecodeFields(FlashPointer(newest_address) + sizeof(RecordHeader), newest.length);
+    m_statistics.sequence = newest.sequence;
+    if (newest_address >= LOG_TOP) {
+        Logger::Log("[Flash] Record #{} lies in the journal area; moving it", newest.sequence);
+        m_pending_migration = true;
+        m_next_record = LOG_BOTTOM;
+        return true;
+    }
+    m_next_record = newest_address + RecordSize(newest.length);
+    if (m_next_record >= LOG_TOP) {
+        m_next_record = LOG_BOTTOM;
+    }
+    m_last_record = newest_address;
+    Logger::Log("[Flash] Updated from record #{} at [0x{:X}] ({} valid records)", newest.sequence, newest_address, valid_records);
+    return true;
+}
+
 void Flash::EraseSettings()
 {
     flash_safe_execute(Erase, nullptr, UINT32_MAX);
+    m_next_record = LOG_BOTTOM;
+    m_last_record = -1;
+    m_statistics.sequence = 0;
 }
 
 bool Flash::SettingsMemoryIsSafe()
 {
     static constexpr ptrdiff_t FLASH_MIDDLE = FLASH_BOTTOM + PICO_FLASH_SIZE_BYTES / 2;
 
-    uint8_t byte = 0;
-    int program_percentage = 0;
-
-    static constexpr ptrdiff_t start = FLASH_SETTINGS_BOTTOM - 1;
-    for (ptrdiff_t flash_address = start; flash_address > FLASH_BOTTOM; --flash_address) {
-        byte = *FlashPointer(flash_address);
-        if (byte != BYTE_EMPTY) {
-            program_percentage = flash_address * 100 / PICO_FLASH_SIZE_BYTES;
-            if (flash_address == start) {
-                Logger::Log("[Flash] Error: Settings compromised; program memory reaches to ~{} % ; address [0x{:X}]",
-                    program_percentage, flash_address);
-                return false;
-            }
-            if (flash_address > FLASH_MIDDLE) {
-                Logger::Log("[Flash] Warning: Settings safety range breached [0x{:X} - 0x{:X}]. Program memory reaches to ~{} %",
-                    FLASH_MIDDLE, FLASH_SETTINGS_BOTTOM, program_percentage);
-                return true;
-            }
-            break;
-        }
+    // The linker refuses images that reach into the settings region (see settings_guard.ld);
+    // this only catches a mismatch between that script and PICO_FLASH_SIZE_BYTES.
+    const ptrdiff_t program_end = reinterpret_cast<uintptr_t>(&__flash_binary_end) - XIP_BASE;
+    const int program_percentage = program_end * 100 / PICO_FLASH_SIZE_BYTES;
+    if (program_end > FLASH_SETTINGS_BOTTOM) {
+        Logger::Log("[Flash] Error: Settings compromised; program memory reaches to ~{} % ; address [0x{:X}]",
+            program_percentage, program_end);
+        return false;
+    }
+    if (program_end > FLASH_MIDDLE) {
+        Logger::Log("[Flash] Warning: Settings safety range breached [0x{:X} - 0x{:X}]. Program memory reaches to ~{} %",
+            FLASH_MIDDLE, FLASH_SETTINGS_BOTTOM, program_percentage);
+        return true;
     }
     Logger::Log("[Flash] Settings memory safe. Program reaches to ~{} %", program_percentage);
+#if FLASH_DIAGNOSTIC_SCAN
+    ScanProgramMemory(program_end);
+#endif
     return true;
 }
 
+#if FLASH_DIAGNOSTIC_SCAN
+void Flash::ScanProgramMemory(const ptrdiff_t program_end)
+{
+    // Anything programmed between the image and the settings is left over from an earlier, larger image
+    const uint32_t start_us = time_us_32();
+    const auto* bottom = reinterpret_cast<const uint32_t*>(FlashPointer(program_end));
+    const auto* word = reinterpret_cast<const uint32_t*>(FlashPointer(FLASH_SETTINGS_BOTTOM));
+    while (word > bottom && *(word - 1) == UINT32_MAX) {
+        --word;
+    }
+    const ptrdiff_t used_end = reinterpret_cast<uintptr_t>(word) - XIP_BASE;
+    Logger::Log("[Flash] Diagnostic scan: flash programmed up to [0x{:X}], image ends at [0x{:X}] ({} us)",
+        used_end, program_end, time_us_32() - start_us);
+}
+#endif
+
 void Flash::UpdateItems()
 {
-    if (UpdateFrom(FLASH_SETTINGS_A)) {
+    if (RecoverFromLog()) {
         return;
     }
-    if (UpdateFrom(FLASH_SETTINGS_B)) {
+    Logger::Log("[Flash] No settings record found. Trying previous A/B layout");
+    if (UpdateFrom(FLASH_SETTINGS_A) || UpdateFrom(FLASH_SETTINGS_B)) {
+        m_pending_migration = true;
         return;
     }
     Logger::Log("[Flash] Failed to read settings from memory. Reverting to Factory Settings");
@@ -89,7 +317,7 @@ void Flash::UpdateItems()
 
 Flash::Settings Flash::FactorySettings()
 {
-    return {
+    Settings settings = {
         .lux_targets = {
             [H00] = 0,
             [H01] = 0,
@@ -118,73 +346,108 @@ Flash::Settings Flash::FactorySettings()
             [LUX_STATIC] = 200,
         },
         .sys_mode = bAUTO /* | bAUTO_HOURLY */,
-        .motor_target = 0,
+        .channels = {},
+        .schedule = sDAILY,
+        .weekly_targets = {},
+        .curve_points = 0,
+        .curve = {},
     };
+    SeedWeeklyTargets(&settings);
+    return settings;
+}
+
+void Flash::SeedWeeklyTargets(Settings* settings)
+{
+    for (auto& day : settings->weekly_targets) {
+        for (size_t hour = H00; hour <= H23; ++hour) {
+            const float lux = std::clamp(settings->lux_targets[hour], 0.0f, static_cast<float>(UINT16_MAX));
+            day[hour] = static_cast<ScheduleLuxType>(lux + 0.5f);
+        }
+    }
 }
 
-void Flash::Program() const
+bool Flash::Program() const
 {
     if (!m_safe) {
         Logger::Log("[Flash] Flash disabled. Cannot Program()");
-        return;
+        return false;
     }
-    ProgramParameters program_parameters {
-        .settings = m_settings,
-        .ok = { true, true },
-        .buffer = &m_buffer,
+
+    m_buffer.fill(BYTE_EMPTY);
+    const size_t length = EncodeFields(m_buffer.data() + sizeof(RecordHeader));
+    const RecordHeader header {
+        .magic = RECORD_MAGIC,
+        .crc = 0,
+        .length = static_cast<uint16_t>(length),
+        .sequence = m_statistics.sequence + 1,
     };
-    flash_safe_execute(EraseAndProgram, &program_parameters, UINT32_MAX);
-    if (!program_parameters.ok.a) {
-        Logger::Log("[Flash] Error: CRC for settings A failed after write");
+    std::memcpy(m_buffer.data(), &header, sizeof(header));
+    const CRCType crc = CRC16::Compute(m_buffer.data() + RECORD_CRC_OFFSET, sizeof(header) - RECORD_CRC_OFFSET);
+    std::memcpy(m_buffer.data() + offsetof(RecordHeader, crc), &crc, CRC_LEN);
+    const size_t size = RecordSize(length);
+
+    if (m_last_record >= 0
+        && std::memcmp(FlashPointer(m_last_record), &header.magic, sizeof(header.magic)) == 0
+        && std::memcmp(FlashPointer(m_last_record) + offsetof(RecordHeader, length), &header.length, sizeof(header.length)) == 0
+        && std::memcmp(FlashPointer(m_last_record) + sizeof(RecordHeader), m_buffer.data() + sizeof(RecordHeader), length) == 0) {
+        ++m_statistics.skipped;
+        Logger::Log("[Flash] Settings match record #{}, nothing to program", m_statistics.sequence);
+        return true;
+    }
+
+    // Records never straddle a sector. Pages left dirty by an interrupted write are skipped;
+    // the start of a sector is always usable, since entering a sector erases it.
+    ptrdiff_t address = m_next_record;
+    while (true) {
+        const ptrdiff_t sector_end = address - (address - LOG_BOTTOM) % FLASH_SECTOR_SIZE + FLASH_SECTOR_SIZE;
+        if (address + static_cast<ptrdiff_t>(size) > sector_end) {
+            address = sector_end < LOG_TOP ? sector_end : LOG_BOTTOM;
+            continue;
+        }
+        if ((address - LOG_BOTTOM) % FLASH_SECTOR_SIZE == 0 || IsErased(address, size)) {
+            break;
+        }
+        address = NextRecordAddress(address);
     }
-    if (!program_parameters.ok.b) {
-        Logger::Log("[Flash] Error: CRC for settings B failed after write");
+    const bool erase = (address - LOG_BOTTOM) % FLASH_SECTOR_SIZE == 0 && !IsErased(address, FLASH_SECTOR_SIZE);
+
+    ProgramParameters program_parameters {
+        .record = m_buffer.data(),
+        .size = size,
+        .address = address,
+        .erase = erase,
+        .ok = false,
+    };
+    const uint32_t start_us = time_us_32();
+    flash_safe_execute(AppendRecord, &program_parameters, UINT32_MAX);
+    m_statistics.last_program_us = time_us_32() - start_us;
+    m_statistics.erases += erase ? 1 : 0;
+    m_next_record = address + size < LOG_TOP ? address + size : LOG_BOTTOM;
+
+    if (!program_parameters.ok) {
+        Logger::Log("[Flash] Error: CRC for record #{} at [0x{:X}] failed after write", header.sequence, address);
+        return false;
     }
+    ++m_statistics.records;
+    m_statistics.sequence = header.sequence;
+    m_last_record = address;
+    Logger::Log("[Flash] Appended record #{} ({} B) at [0x{:X}] in {} us{}",
+        header.sequence, size, address, m_statistics.last_program_us, erase ? " (sector erased)" : "");
+    return true;
 }
 
 void Flash::Erase(void* params)
 {
     (void)params;
-    flash_range_erase(FLASH_SETTINGS_A, SETTINGS_MEMORY_SIZE);
-    flash_range_erase(FLASH_SETTINGS_B, SETTINGS_MEMORY_SIZE);
-}
-
-void Flash::EraseAndProgram(void* program_parameters)
-{
-    const auto settings = static_cast<ProgramParameters*>(program_parameters)->settings;
-    auto* ok = &static_cast<ProgramParameters*>(program_parameters)->ok;
-    auto* buffer = static_cast<ProgramParameters*>(program_parameters)->buffer;
-
-    buffer->fill(BYTE_EMPTY);
-
-    ptrdiff_t index = 0;
-    std::memcpy(buffer->data() + index, settings.lux_targets, LUX_MAP_LEN);
-    index += LUX_MAP_LEN;
-    std::memcpy(buffer->data() + index, &settings.sys_mode, SYSTEM_MODE_LEN);
-    index += SYSTEM_MODE_LEN;
-    std::memcpy(buffer->data() + index, &settings.motor_target, MOTOR_TARGET_LEN);
-    index += MOTOR_TARGET_LEN;
-
-    uint16_t crc = CRC16(buffer->data(), SETTINGS_LEN - CRC_LEN);
-    crc = crc >> 8 | crc << 8;
-    std::memcpy(buffer->data() + index, &crc, CRC_LEN);
-
-    flash_range_erase(FLASH_SETTINGS_A, SETTINGS_MEMORY_SIZE);
-    flash_range_program(FLASH_SETTINGS_A, buffer->data(), SETTINGS_MEMORY_SIZE);
-    ok->a = CRC16(FlashPointer(FLASH_SETTINGS_A), SETTINGS_LEN) == 0;
-
-    flash_range_erase(FLASH_SETTINGS_B, SETTINGS_MEMORY_SIZE);
-    flash_range_program(FLASH_SETTINGS_B, buffer->data(), SETTINGS_MEMORY_SIZE);
-    ok->b = CRC16(FlashPointer(FLASH_SETTINGS_B), SETTINGS_LEN) == 0;
+    flash_range_erase(LOG_BOTTOM, LOG_TOP - LOG_BOTTOM);
 }
 
-uint16_t Flash::CRC16(const uint8_t* buf, size_t length)
+void Flash::AppendRecord(void* program_parameters)
 {
-    uint16_t crc = 0xFFFF;
-    while (length--) {
-        uint8_t x = crc >> 8 ^ *buf++;
-        x ^= x >> 4;
-        crc = (crc << 8) ^ (static_cast<uint16_t>(x << 5) ^ static_cast<uint16_t>(x));
+    auto* params = static_cast<ProgramParameters*>(program_parameters);
+    if (params->erase) {
+        flash_range_erase(params->address, FLASH_SECTOR_SIZE);
     }
-    return crc;
+    flash_range_program(params->address, params->record, params->size);
+    params->ok = RecordIsIntact(params->address);
 }
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 #include <boards/pico_w.h>
 #include <hardware/flash.h>
@@ -16,6 +18,9 @@ class Flash {
     using LuxType = float;
     using ModeType = uint8_t;
     using MotorTargetType = uint8_t;
+    using BeltType = uint16_t;
+    using ScheduleType = uint8_t;
+    using ScheduleLuxType = uint16_t;
     using CRCType = uint16_t;
 
     static constexpr size_t LUX_LEN = sizeof(LuxType);
@@ -25,16 +30,68 @@ class Flash {
     static constexpr size_t MOTOR_TARGET_LEN = sizeof(MotorTargetType);
     static constexpr size_t CRC_LEN = sizeof(CRCType);
 
-    static constexpr size_t SETTINGS_LEN = CRC_LEN + LUX_MAP_LEN + SYSTEM_MODE_LEN + MOTOR_TARGET_LEN;
+    static constexpr size_t BELT_LEN = sizeof(BeltType);
+    static constexpr size_t DAYS = 7;
+    static constexpr size_t HOURS = 24;
+
+    static constexpr size_t LEGACY_PAYLOAD_LEN = LUX_MAP_LEN + SYSTEM_MODE_LEN + MOTOR_TARGET_LEN;
+    static constexpr size_t SETTINGS_LEN = CRC_LEN + LEGACY_PAYLOAD_LEN;
 
     static constexpr ptrdiff_t SETTINGS_CAPACITY = PICO_FLASH_SIZE_BYTES / 4;
     static constexpr ptrdiff_t FLASH_SETTINGS_BOTTOM = FLASH_BOTTOM + PICO_FLASH_SIZE_BYTES - SETTINGS_CAPACITY;
     static constexpr ptrdiff_t FLASH_SETTINGS_TOP = FLASH_SETTINGS_BOTTOM + SETTINGS_CAPACITY;
+    static_assert(FLASH_SETTINGS_BOTTOM == PICO_FLASH_SIZE_BYTES * 3 / 4, "Keep in sync with settings_guard.ld");
+
+    /// Every Program() appends one record of whole pages to a log spanning the settings region.
+    /// Records are never rewritten; a sector is erased only when the log wraps into it again.
+    struct RecordHeader {
+        uint32_t magic;
+        /// Over the rest of the header only; every field carries its own
+        CRCType crc;
+        uint16_t length;
+        uint32_t sequence;
+    };
+    /// Payload of FieldHeader + value pairs
+    static constexpr uint32_t RECORD_MAGIC = 0x484C5453; // "STLH"
+    static constexpr size_t RECORD_CRC_OFFSET = offsetof(RecordHeader, length);
+    static constexpr size_t MAX_RECORD_SIZE = 4 * FLASH_PAGE_SIZE;
+    static constexpr size_t RecordSize(const size_t payload_length)
+    {
+        return (sizeof(RecordHeader) + payload_length + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+    }
+
+    /// Fields are found by tag, so they can be added, reordered or dropped without a format
+    /// break. Each field stands on its own CRC: unknown tags are skipped, and a field of an
+    /// unknown version or with a damaged value keeps what the newest intact record held for it,
+    /// or else its factory value.
+    enum Field : uint8_t {
+        fLUX_TARGETS = 1,
+        fSYSTEM_MODE = 2,
+        fMOTOR_TARGET = 3,
+        fBELT = 4, /// belt_max, belt_position
+        fSCHEDULE = 5,
+        fWEEKLY_TARGETS = 6,
+        fCURVE = 7, /// curve_points, then all CURVE_CAPACITY breakpoints
+        fCHANNELS = 8, /// motor_target, belt_max, belt_position of channels 1 and up; channel 0 keeps the fields above
+    };
+    struct FieldHeader {
+        Field tag;
+        uint8_t version;
+        uint16_t length;
+        CRCType crc; /// over the value
+    };
+    static constexpr uint8_t FIELD_VERSION = 1;
 
-    static_assert(SETTINGS_LEN * 2 < SETTINGS_CAPACITY);
+    /// The top sectors of the settings region hold the PositionJournal
+    static constexpr ptrdiff_t JOURNAL_CAPACITY = 8 * FLASH_SECTOR_SIZE;
+    static constexpr ptrdiff_t LOG_BOTTOM = FLASH_SETTINGS_BOTTOM;
+    static constexpr ptrdiff_t LOG_TOP = FLASH_SETTINGS_TOP - JOURNAL_CAPACITY;
 
-    static constexpr size_t SETTINGS_MEMORY_SIZE = (SETTINGS_LEN + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+    static_assert(MAX_RECORD_SIZE <= FLASH_SECTOR_SIZE);
+    static_assert(LOG_BOTTOM % FLASH_SECTOR_SIZE == 0 && LOG_TOP % FLASH_SECTOR_SIZE == 0);
+    static_assert(LOG_TOP - LOG_BOTTOM >= 2 * FLASH_SECTOR_SIZE, "Newest record must survive erasing the next sector");
 
+    /// Layout used before the log; only read once to migrate existing settings
     static constexpr ptrdiff_t FLASH_SETTINGS_A = SETTINGS_CAPACITY * 3;
     static constexpr ptrdiff_t FLASH_SETTINGS_B = FLASH_SETTINGS_A + SETTINGS_CAPACITY / 2;
 
@@ -52,43 +109,132 @@ public:
         bAUTO = 0b01,
         bAUTO_HOURLY = 0b10,
     };
+    /// Which targets bAUTO_HOURLY follows
+    enum Schedule : ScheduleType {
+        sDAILY, /// lux_targets[H00..H23], the same every day
+        sWEEKLY, /// weekly_targets of the current day of the week
+        sCURVE, /// curve breakpoints, the same every day
+    };
+    struct Breakpoint {
+        uint16_t minute; /// of the day
+        ScheduleLuxType lux;
+    };
+    static constexpr size_t CURVE_CAPACITY = 16;
+    /// Curtains one controller can drive; the settings always hold this many
+    static constexpr size_t MAX_MOTOR_CHANNELS = 3;
+
+    struct Channel {
+        MotorTargetType motor_target;
+        /// Motor calibration; belt_max 0 means uncalibrated
+        BeltType belt_max;
+        BeltType belt_position;
+
+        [[nodiscard]] bool operator==(const Channel& other) const
+        {
+            return motor_target == other.motor_target && belt_max == other.belt_max && belt_position == other.belt_position;
+        }
+    };
 
     struct Settings {
         LuxType lux_targets[LUX_TARGETS];
         ModeType sys_mode;
-        MotorTargetType motor_target;
+        /// Indexed by motor channel
+        Channel channels[MAX_MOTOR_CHANNELS];
+        ScheduleType schedule;
+        /// Whole lux, indexed by datetime_t::dotw (0 is Sunday) and hour
+        ScheduleLuxType weekly_targets[DAYS][HOURS];
+        /// Sorted by minute; unused breakpoints are zero
+        uint8_t curve_points;
+        Breakpoint curve[CURVE_CAPACITY];
+
+        /// Bytewise, the same way the flash image would differ
+        [[nodiscard]] bool operator==(const Settings& other) const
+        {
+            return std::memcmp(lux_targets, other.lux_targets, sizeof(lux_targets)) == 0
+                && sys_mode == other.sys_mode
+                && std::equal(channels, channels + MAX_MOTOR_CHANNELS, other.channels)
+                && schedule == other.schedule
+                && std::memcmp(weekly_targets, other.weekly_targets, sizeof(weekly_targets)) == 0
+                && curve_points == other.curve_points
+                && std::memcmp(curve, other.curve, sizeof(curve)) == 0;
+        }
+        [[nodiscard]] bool operator!=(const Settings& other) const { return !(*this == other); }
     };
 
+    struct Statistics {
+        uint32_t records; /// appended since boot
+        uint32_t skipped; /// Program() calls that matched the newest record
+        uint32_t erases; /// sectors erased since boot
+        uint32_t last_program_us;
+        uint32_t sequence; /// of the newest record
+    };
+
+    static constexpr ptrdiff_t JOURNAL_BOTTOM = LOG_TOP;
+    static constexpr ptrdiff_t JOURNAL_TOP = FLASH_SETTINGS_TOP;
+
     void EraseSettings();
+    [[nodiscard]] Statistics GetStatistics() const { return m_statistics; }
 
 protected:
     explicit Flash();
 
     struct ProgramParameters {
-        const Settings settings;
-        struct {
-            bool a;
-            bool b;
-        } ok;
-        std::array<uint8_t, SETTINGS_MEMORY_SIZE>* buffer;
+        const uint8_t* record;
+        size_t size;
+        ptrdiff_t address;
+        bool erase;
+        bool ok;
     };
 
-    void Program() const;
+    /// True once the settings are in flash, including when the newest record already holds them
+    bool Program() const;
+    /// False if the settings region overlaps the program; nothing is ever programmed then
+    [[nodiscard]] bool Enabled() const { return m_safe; }
     [[nodiscard]] Settings& AccessSettings() const { return m_settings; }
+    /// The settings were read from somewhere the log will not keep them; they must be programmed again
+    /// before anything else writes to flash
+    [[nodiscard]] bool PendingMigration() const { return m_pending_migration; }
 
 private:
+    static constexpr size_t CURVE_FIELD_LEN = 1 + sizeof(Settings::curve);
+    static constexpr size_t CHANNEL_FIELD_LEN = MOTOR_TARGET_LEN + 2 * BELT_LEN;
+    static constexpr size_t CHANNELS_FIELD_LEN = (MAX_MOTOR_CHANNELS - 1) * CHANNEL_FIELD_LEN;
+
     static bool SettingsMemoryIsSafe();
+#if FLASH_DIAGNOSTIC_SCAN
+    static void ScanProgramMemory(ptrdiff_t program_end);
+#endif
     void UpdateItems();
 
     [[nodiscard]] static Settings FactorySettings();
+    /// For settings that predate weekly schedules: every day follows the daily targets
+    static void SeedWeeklyTargets(Settings* settings);
     void WriteSettingsBlocking(const Settings& items);
 
-    static void Erase(void* settings_flash_address);
-    static void EraseAndProgram(void* program_parameters);
+    static void Erase(void* params);
+    static void AppendRecord(void* program_parameters);
+    bool RecoverFromLog();
     bool UpdateFrom(ptrdiff_t settings_address);
-    static uint16_t CRC16(const uint8_t* buf, size_t length);
+    /// The fixed layout of the A/B copies: lux targets, system mode, motor target
+    void DeserializeFixed(const uint8_t* payload);
+    void DecodeFields(const uint8_t* payload, size_t length);
+    [[nodiscard]] size_t EncodeFields(uint8_t* payload) const;
+    static uint8_t* EncodeField(uint8_t* out, Field tag, const void* value, uint16_t length);
+    [[nodiscard]] static const uint8_t* FindField(const uint8_t* payload, size_t length, Field tag, uint16_t value_length);
+    /// Header checks out, so the record can be walked; its fields may still be damaged
+    [[nodiscard]] static bool RecordIsValid(ptrdiff_t record_address);
+    /// Valid, and every field checks out too
+    [[nodiscard]] static bool RecordIsIntact(ptrdiff_t record_address);
+    [[nodiscard]] static bool IsErased(ptrdiff_t flash_address, size_t length);
+    [[nodiscard]] static ptrdiff_t NextRecordAddress(ptrdiff_t record_address);
 
     mutable Settings m_settings;
     bool m_safe = true;
-    mutable std::array<uint8_t, SETTINGS_MEMORY_SIZE> m_buffer;
+    mutable std::array<uint8_t, MAX_RECORD_SIZE> m_buffer;
+    /// Where the next record goes; may still hold the remains of an interrupted write
+    mutable ptrdiff_t m_next_record = LOG_BOTTOM;
+    /// Newest valid record, or -1 if there is none yet
+    mutable ptrdiff_t m_last_record = -1;
+    bool m_pending_migration = false;
+    mutable Statistics m_statistics = {};
 };
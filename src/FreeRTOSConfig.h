@@ -65,6 +65,8 @@
 // todo need this for lwip FreeRTOS sys_arch to compile
 #define configENABLE_BACKWARD_COMPATIBILITY     1
 #define configNUM_THREAD_LOCAL_STORAGE_POINTERS 5
+/* See TaskNotificationIndex in config.h: the default plus one per motor channel */
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES   4
 
 /* System */
 #define configSTACK_DEPTH_TYPE                  uint32_t
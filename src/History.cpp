@@ -0,0 +1,238 @@
+#include "History.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+#include "Logger.hpp"
+#include "config.h"
+
+static float Average(const float average, const uint32_t count, const float other_average, const uint32_t other_count)
+{
+    if (count + other_count == 0) {
+        return 0.0f;
+    }
+    return (average * count + other_average * other_count) / (count + other_count);
+}
+
+void History::Bucket::Merge(const Bucket& other)
+{
+    const float weight = count;
+    const float other_weight = other.count;
+    const float total = weight + other_weight;
+    if (!HasLux()) {
+        lux_min = other.lux_min;
+        lux_max = other.lux_max;
+    } else if (other.HasLux()) {
+        lux_min = std::min(lux_min, other.lux_min);
+        lux_max = std::max(lux_max, other.lux_max);
+    }
+    lux1_avg = Average(lux1_avg, lux1_count, other.lux1_avg, other.lux1_count);
+    lux2_avg = Average(lux2_avg, lux2_count, other.lux2_avg, other.lux2_count);
+    lux1_count = static_cast<uint16_t>(std::min<uint32_t>(UINT16_MAX, lux1_count + other.lux1_count));
+    lux2_count = static_cast<uint16_t>(std::min<uint32_t>(UINT16_MAX, lux2_count + other.lux2_count));
+    target_avg = (target_avg * weight + other.target_avg * other_weight) / total;
+    position_min = std::min(position_min, other.position_min);
+    position_max = std::max(position_max, other.position_max);
+    position_avg = static_cast<uint8_t>(std::lround((position_avg * weight + other.position_avg * other_weight) / total));
+    count = static_cast<uint16_t>(std::min<uint32_t>(UINT16_MAX, count + other.count));
+}
+
+History::History(const Parameters& parameters)
+    : m_v_measurement_als1(parameters.v_latest_measurement_als1)
+    , m_v_measurement_als2(parameters.v_latest_measurement_als2)
+    , m_v_lux_target(parameters.v_lux_target)
+    , m_v_belt_position(parameters.v_belt_position)
+    , m_rtc(parameters.rtc)
+    , m_access("HistoryAccess")
+    , m_rings({
+          Ring { new Bucket[RAW_CAPACITY], RAW_CAPACITY, 0, SAMPLE_PERIOD / configTICK_RATE_HZ },
+          Ring { new Bucket[MINUTES_CAPACITY], MINUTES_CAPACITY, 0, 60 },
+          Ring { new Bucket[QUARTERS_CAPACITY], QUARTERS_CAPACITY, 0, 15 * 60 },
+      })
+{
+    if (xTaskCreate(
+            TASK_KONDOM(History, Task),
+            parameters.task_name,
+            TaskStackSize::HISTORY,
+            this,
+            TaskPriority::HISTORY,
+            &m_handle)
+        == pdPASS) {
+        Logger::Log("Created task [{}]", parameters.task_name);
+    } else {
+        Logger::Log("Error: Failed to create task [{}]", parameters.task_name);
+    }
+}
+
+void History::Task()
+{
+    Logger::Log("Initiated");
+    TickType_t previous_sample_tick = xTaskGetTickCount();
+    while (true) {
+        xTaskDelayUntil(&previous_sample_tick, SAMPLE_PERIOD);
+        Bucket sample;
+        if (Sample(&sample)) {
+            Append(sample);
+        }
+    }
+}
+
+bool History::Sample(Bucket* sample) const
+{
+    if (!m_rtc->IsSet()) {
+        // timestamps would be meaningless
+        return false;
+    }
+    LuxMeasurement als1 = { 0, -1.0f };
+    LuxMeasurement als2 = { 0, -1.0f };
+    m_v_measurement_als1->Peek(&als1, 0);
+    m_v_measurement_als2->Peek(&als2, 0);
+    const bool has_als1 = als1.lux >= 0.0f;
+    const bool has_als2 = als2.lux >= 0.0f;
+    // -1 marks a missing sensor; it must not end up in the statistics
+    float lux = 0.0f;
+    if (has_als1 && has_als2) {
+        lux = (als1.lux + als2.lux) / 2.0f;
+    } else if (has_als1) {
+        lux = als1.lux;
+    } else if (has_als2) {
+        lux = als2.lux;
+    }
+    float target = 0.0f;
+    m_v_lux_target->Peek(&target, 0);
+    uint8_t position = 0;
+    m_v_belt_position->Peek(&position, 0);
+
+    *sample = {
+        .timestamp = RTC::ToEpoch(m_rtc->GetDatetime()),
+        .count = 1,
+        .lux1_count = has_als1,
+        .lux2_count = has_als2,
+        .lux_min = lux,
+        .lux_max = lux,
+        .lux1_avg = has_als1 ? als1.lux : 0.0f,
+        .lux2_avg = has_als2 ? als2.lux : 0.0f,
+        .target_avg = target,
+        .position_min = position,
+        .position_max = position,
+        .position_avg = position,
+    };
+    return true;
+}
+
+void History::Append(const Bucket& sample)
+{
+    std::lock_guard exclusive(m_access);
+    Bucket bucket = sample;
+    for (Tier tier = RAW;; tier = static_cast<Tier>(tier + 1)) {
+        Ring& ring = m_rings.at(tier);
+        ring.buckets[ring.head % ring.capacity] = bucket;
+        ++ring.head;
+
+        const auto coarser = static_cast<Tier>(tier + 1);
+        if (coarser == TIER_COUNT) {
+            return;
+        }
+        const uint32_t period = m_rings.at(coarser).period_s;
+        const uint32_t start = bucket.timestamp - bucket.timestamp % period;
+        Bucket& open = m_open.at(coarser);
+        if (open.count != 0 && open.timestamp != start) {
+            // the closed bucket goes into the coarser ring on the next round
+            const Bucket closed = open;
+            open = bucket;
+            open.timestamp = start;
+            bucket = closed;
+            continue;
+        }
+        if (open.count == 0) {
+            open = bucket;
+            open.timestamp = start;
+        } else {
+            open.Merge(bucket);
+        }
+        return;
+    }
+}
+
+History::Cursor History::Begin(const uint32_t from, const uint32_t to, const uint32_t step) const
+{
+    Tier tier = RAW;
+    if (step >= m_rings.at(QUARTERS).period_s) {
+        tier = QUARTERS;
+    } else if (step >= m_rings.at(MINUTES).period_s) {
+        tier = MINUTES;
+    }
+
+    std::lock_guard exclusive(m_access);
+    while (tier + 1 != TIER_COUNT) {
+        const Ring& ring = m_rings.at(tier);
+        if (ring.head != 0 && Oldest(ring) <= from) {
+            break;
+        }
+        // the requested range reaches further back than this tier remembers; a coarser tier is only
+        // worth its resolution if its oldest bucket ended before this tier's oldest one began
+        const Ring& coarser = m_rings.at(tier + 1);
+        if (coarser.head == 0 || (ring.head != 0 && Oldest(coarser) + coarser.period_s > Oldest(ring))) {
+            break;
+        }
+        tier = static_cast<Tier>(tier + 1);
+    }
+    const Ring& ring = m_rings.at(tier);
+
+    return {
+        .from = from,
+        .to = to,
+        .step = step,
+        .tier = tier,
+        .sequence = ring.head - std::min(ring.head, ring.capacity),
+        .pending = {},
+        .open_taken = false,
+        .done = from > to,
+    };
+}
+
+size_t History::Next(Cursor* cursor, Bucket* out, const size_t max) const
+{
+    size_t produced = 0;
+    std::lock_guard exclusive(m_access);
+    const Ring& ring = m_rings.at(cursor->tier);
+    const uint32_t oldest = ring.head - std::min(ring.head, ring.capacity);
+    if (cursor->sequence < oldest) {
+        // overwritten while streaming; skip ahead
+        cursor->sequence = oldest;
+    }
+    while (produced < max && !cursor->done) {
+        const Bucket* bucket = nullptr;
+        // once the open bucket went out, whatever the ring gained since was folded from it
+        if (!cursor->open_taken && cursor->sequence != ring.head) {
+            bucket = &ring.buckets[cursor->sequence % ring.capacity];
+        } else if (!cursor->open_taken && m_open.at(cursor->tier).count != 0) {
+            bucket = &m_open.at(cursor->tier);
+        }
+        if (bucket == nullptr || bucket->timestamp > cursor->to) {
+            if (cursor->pending.count != 0) {
+                out[produced++] = cursor->pending;
+            }
+            cursor->done = true;
+            break;
+        }
+        if (cursor->sequence != ring.head) {
+            ++cursor->sequence;
+        } else {
+            cursor->open_taken = true;
+        }
+        if (bucket->timestamp < cursor->from) {
+            continue;
+        }
+        if (cursor->pending.count == 0) {
+            cursor->pending = *bucket;
+        } else if (bucket->timestamp >= cursor->pending.timestamp + cursor->step) {
+            out[produced++] = cursor->pending;
+            cursor->pending = *bucket;
+        } else {
+            cursor->pending.Merge(*bucket);
+        }
+    }
+    return produced;
+}
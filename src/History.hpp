@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "AmbientLightSensor.hpp"
+#include "Queue.hpp"
+#include "RTC.hpp"
+#include "Semaphore.hpp"
+
+/// Keeps a fixed amount of lux / target / belt position history in RAM.
+/// Samples are taken every SAMPLE_PERIOD and folded into progressively coarser
+/// tiers, each of which remembers min / max / avg of what it replaced.
+class History {
+public:
+    struct Parameters {
+        const char* task_name;
+
+        RTOS::Variable<LuxMeasurement>* v_latest_measurement_als1;
+        RTOS::Variable<LuxMeasurement>* v_latest_measurement_als2;
+        RTOS::Variable<float>* v_lux_target;
+        RTOS::Variable<uint8_t>* v_belt_position;
+
+        RTC* rtc;
+    };
+
+    /// One or more samples merged together. Timestamps are seconds since the Unix epoch.
+    struct Bucket {
+        uint32_t timestamp;
+        uint16_t count;
+        /// Samples that had a reading from each sensor; the lux statistics only cover those
+        uint16_t lux1_count;
+        uint16_t lux2_count;
+        float lux_min;
+        float lux_max;
+        float lux1_avg;
+        float lux2_avg;
+        float target_avg;
+        uint8_t position_min;
+        uint8_t position_max;
+        uint8_t position_avg;
+
+        void Merge(const Bucket& other);
+        /// Whether lux_min and lux_max hold anything
+        [[nodiscard]] bool HasLux() const { return lux1_count != 0 || lux2_count != 0; }
+    };
+
+    enum Tier : uint8_t {
+        RAW,
+        MINUTES,
+        QUARTERS,
+        TIER_COUNT,
+    };
+
+    struct Cursor {
+        uint32_t from;
+        uint32_t to;
+        uint32_t step;
+        Tier tier;
+        uint32_t sequence;
+        Bucket pending;
+        /// The tier's bucket still being filled was streamed; it ends the range
+        bool open_taken;
+        bool done;
+    };
+
+    explicit History(const Parameters& parameters);
+
+    /// 'step' picks the coarsest tier that still resolves it, RAW for 0. If 'from' lies further back
+    /// than that tier remembers, a coarser tier is used as long as it reaches further back.
+    [[nodiscard]] Cursor Begin(uint32_t from, uint32_t to, uint32_t step) const;
+    /// Fills 'out' with up to 'max' buckets, each covering at least 'step' seconds; with 'step' 0,
+    /// the buckets of the tier as they are. The bucket the tier is still filling comes last.
+    /// Returns 0 once the range is exhausted.
+    size_t Next(Cursor* cursor, Bucket* out, size_t max) const;
+
+    static constexpr TickType_t SAMPLE_PERIOD = pdMS_TO_TICKS(10'000);
+
+private:
+    struct Ring {
+        Bucket* buckets;
+        uint32_t capacity;
+        /// Number of buckets ever written; the oldest valid one is head - min(head, capacity)
+        uint32_t head;
+        uint32_t period_s;
+    };
+
+    void Task();
+    [[nodiscard]] bool Sample(Bucket* sample) const;
+    /// Adds a RAW sample and folds it into the coarser tiers
+    void Append(const Bucket& sample);
+    /// Timestamp of the oldest bucket of 'ring', which must not be empty
+    [[nodiscard]] static uint32_t Oldest(const Ring& ring) { return ring.buckets[(ring.head - std::min(ring.head, ring.capacity)) % ring.capacity].timestamp; }
+
+    static constexpr uint32_t RAW_CAPACITY = 180; // 30 min
+    static constexpr uint32_t MINUTES_CAPACITY = 240; // 4 h
+    static constexpr uint32_t QUARTERS_CAPACITY = 384; // 4 d
+
+    RTOS::Variable<LuxMeasurement>* m_v_measurement_als1;
+    RTOS::Variable<LuxMeasurement>* m_v_measurement_als2;
+    RTOS::Variable<float>* m_v_lux_target;
+    RTOS::Variable<uint8_t>* m_v_belt_position;
+    RTC* m_rtc;
+
+    mutable RTOS::Mutex m_access;
+    std::array<Ring, TIER_COUNT> m_rings;
+    /// Buckets of the coarser tiers that are still being filled; guarded by m_access like the rings
+    std::array<Bucket, TIER_COUNT> m_open = {};
+
+    TaskHandle_t m_handle = nullptr;
+};
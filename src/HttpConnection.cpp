@@ -1,21 +1,43 @@
 #include "HttpConnection.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 
 #include <ArduinoJson.hpp>
+#include <hardware/timer.h>
+#include <mbedtls/base64.h>
+#include <mbedtls/sha1.h>
 
 #include "HttpServer.hpp"
 #include "Logger.hpp"
 
 #define HTTP_ENABLE_DEBUG 0
 
+static constexpr std::string_view WEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+enum WebSocketOpcode : uint8_t {
+    WS_OPCODE_CONTINUATION = 0x0,
+    WS_OPCODE_TEXT = 0x1,
+    WS_OPCODE_BINARY = 0x2,
+    WS_OPCODE_CLOSE = 0x8,
+    WS_OPCODE_PING = 0x9,
+    WS_OPCODE_PONG = 0xA,
+};
+
 HttpConnection::HttpConnection(const ConstructionParameters& params)
     : m_server(params.server)
     , m_pcb(params.pcb)
+    , m_tls(params.tls)
 {
-    tcp_arg(m_pcb, this);
-    tcp_recv(m_pcb, [](void* arg, tcp_pcb* pcb, pbuf* p, err_t err) -> err_t {
+#if HTTPS_ENABLED
+    if (m_tls) {
+        m_server->OpenTls();
+        m_handshake_start_us = time_us_32();
+    }
+#endif
+    altcp_arg(m_pcb, this);
+    altcp_recv(m_pcb, [](void* arg, altcp_pcb* pcb, pbuf* p, err_t err) -> err_t {
         (void)pcb;
         auto* conn = static_cast<HttpConnection*>(arg);
         auto ret = conn->RecvCallback(p, err);
@@ -27,7 +49,7 @@ HttpConnection::HttpConnection(const ConstructionParameters& params)
         }
         return ret;
     });
-    tcp_sent(m_pcb, [](void* arg, tcp_pcb* pcb, u16_t len) -> err_t {
+    altcp_sent(m_pcb, [](void* arg, altcp_pcb* pcb, u16_t len) -> err_t {
         (void)pcb;
         auto* conn = static_cast<HttpConnection*>(arg);
         auto ret = conn->SentCallback(len);
@@ -36,7 +58,7 @@ HttpConnection::HttpConnection(const ConstructionParameters& params)
         }
         return ret;
     });
-    tcp_err(m_pcb, [](void* arg, err_t err) -> void {
+    altcp_err(m_pcb, [](void* arg, err_t err) -> void {
         auto* conn = static_cast<HttpConnection*>(arg);
         conn->m_pcb = nullptr;
         conn->ErrorCallback(err);
@@ -51,15 +73,20 @@ HttpConnection::~HttpConnection()
     Logger::Log("HTTP: Closed");
 #endif
     Abort();
+#if HTTPS_ENABLED
+    if (m_tls) {
+        m_server->CloseTls();
+    }
+#endif
 }
 
 err_t HttpConnection::Abort()
 {
     if (m_pcb != nullptr) {
-        tcp_recv(m_pcb, nullptr);
-        tcp_sent(m_pcb, nullptr);
-        tcp_err(m_pcb, nullptr);
-        tcp_abort(m_pcb);
+        altcp_recv(m_pcb, nullptr);
+        altcp_sent(m_pcb, nullptr);
+        altcp_err(m_pcb, nullptr);
+        altcp_abort(m_pcb);
         m_pcb = nullptr;
     }
     return ERR_ABRT;
@@ -68,10 +95,10 @@ err_t HttpConnection::Abort()
 void HttpConnection::Close()
 {
     assert(m_pcb);
-    tcp_recv(m_pcb, nullptr);
-    tcp_sent(m_pcb, nullptr);
-    tcp_err(m_pcb, nullptr);
-    err_t success = tcp_close(m_pcb);
+    altcp_recv(m_pcb, nullptr);
+    altcp_sent(m_pcb, nullptr);
+    altcp_err(m_pcb, nullptr);
+    err_t success = altcp_close(m_pcb);
     assert(success == ERR_OK);
     m_tx_closed = m_rx_closed = true;
     m_pcb = nullptr;
@@ -80,11 +107,11 @@ void HttpConnection::Close()
 void HttpConnection::ShutdownTransmit()
 {
     assert(m_pcb);
-    tcp_sent(m_pcb, nullptr);
+    altcp_sent(m_pcb, nullptr);
     if (m_rx_closed) {
-        tcp_err(m_pcb, nullptr);
+        altcp_err(m_pcb, nullptr);
     }
-    err_t success = tcp_shutdown(m_pcb, 0, 1);
+    err_t success = altcp_shutdown(m_pcb, 0, 1);
     assert(success == ERR_OK);
     m_tx_closed = true;
     if (m_rx_closed) {
@@ -95,11 +122,11 @@ void HttpConnection::ShutdownTransmit()
 void HttpConnection::ShutdownReceive()
 {
     assert(m_pcb);
-    tcp_recv(m_pcb, nullptr);
+    altcp_recv(m_pcb, nullptr);
     if (m_tx_closed) {
-        tcp_err(m_pcb, nullptr);
+        altcp_err(m_pcb, nullptr);
     }
-    err_t success = tcp_shutdown(m_pcb, 1, 0);
+    err_t success = altcp_shutdown(m_pcb, 1, 0);
     assert(success == ERR_OK);
     m_rx_closed = true;
     if (m_tx_closed) {
@@ -110,10 +137,10 @@ void HttpConnection::ShutdownReceive()
 void HttpConnection::Shutdown()
 {
     assert(m_pcb);
-    tcp_recv(m_pcb, nullptr);
-    tcp_sent(m_pcb, nullptr);
-    tcp_err(m_pcb, nullptr);
-    err_t success = tcp_shutdown(m_pcb, 1, 1);
+    altcp_recv(m_pcb, nullptr);
+    altcp_sent(m_pcb, nullptr);
+    altcp_err(m_pcb, nullptr);
+    err_t success = altcp_shutdown(m_pcb, 1, 1);
     assert(success == ERR_OK);
     m_tx_closed = m_rx_closed = true;
     m_pcb = nullptr;
@@ -179,6 +206,13 @@ err_t HttpConnection::RecvCallback(pbuf* p, err_t err)
 #if HTTP_ENABLE_DEBUG
     dump_pbuf(p);
 #endif
+#if HTTPS_ENABLED
+    if (m_handshake_start_us != 0) {
+        m_server->RecordTlsHandshake(time_us_32() - m_handshake_start_us);
+        m_handshake_start_us = 0;
+    }
+#endif
+    const u16_t received = p->tot_len;
 
     while (true) {
         const uint8_t* payload = static_cast<const uint8_t*>(p->payload);
@@ -201,12 +235,19 @@ err_t HttpConnection::RecvCallback(pbuf* p, err_t err)
     if (!HandleRequest()) {
         return Abort();
     }
+    if (m_pcb != nullptr) {
+        // long-lived connections (event stream, websocket) would otherwise run out of receive window
+        altcp_recved(m_pcb, received);
+    }
 
     return ERR_OK;
 }
 
 err_t HttpConnection::SentCallback(u16_t len)
 {
+    if (m_streaming_history) {
+        StreamHistory();
+    }
     return ERR_OK;
 }
 
@@ -224,7 +265,7 @@ void HttpConnection::RespondWith(const char* status, const char* body)
             "Connection: close\r\n"
             "\r\n",
             status);
-        err = tcp_write(m_pcb, head.c_str(), head.size(), TCP_WRITE_FLAG_COPY);
+        err = altcp_write(m_pcb, head.c_str(), head.size(), TCP_WRITE_FLAG_COPY);
         assert(err == ERR_OK);
     } else {
         size_t body_len = strlen(body);
@@ -235,12 +276,12 @@ void HttpConnection::RespondWith(const char* status, const char* body)
             "Content-Length: {}\r\n"
             "\r\n",
             status, body_len);
-        err = tcp_write(m_pcb, head.c_str(), head.size(), TCP_WRITE_FLAG_COPY);
+        err = altcp_write(m_pcb, head.c_str(), head.size(), TCP_WRITE_FLAG_COPY);
         assert(err == ERR_OK);
-        err = tcp_write(m_pcb, body, body_len, TCP_WRITE_FLAG_COPY);
+        err = altcp_write(m_pcb, body, body_len, TCP_WRITE_FLAG_COPY);
         assert(err == ERR_OK);
     }
-    err = tcp_output(m_pcb);
+    err = altcp_output(m_pcb);
     assert(err == ERR_OK);
 }
 
@@ -250,23 +291,23 @@ size_t HttpConnection::WriteToBuffer(const uint8_t* data, size_t len)
     if (len > remaining) {
         len = remaining;
     }
-
     memcpy(m_buffer.data() + m_buffer_offset, data, len);
     m_buffer_offset += len;
 
     return len;
 }
 
-static bool ParseSizeTFromStringView(std::string_view input_string, size_t* output_number)
+static constexpr size_t MAXIMUM_ACCEPTABLE_NUMBER = 65536;
+
+static bool ParseSizeTFromStringView(std::string_view input_string, size_t* output_number, size_t maximum = MAXIMUM_ACCEPTABLE_NUMBER)
 {
-    constexpr size_t MAXIMUM_ACCEPTABLE_NUMBER = 65536;
     size_t output_accumulator = 0;
     for (char input_character : input_string) {
         if (input_character < '0' || input_character > '9') {
             return false;
         }
         output_accumulator = output_accumulator * 10 + (input_character - '0');
-        if (output_accumulator > MAXIMUM_ACCEPTABLE_NUMBER) {
+        if (output_accumulator > maximum) {
             return false;
         }
     }
@@ -276,6 +317,9 @@ static bool ParseSizeTFromStringView(std::string_view input_string, size_t* outp
 
 bool HttpConnection::HandleRequest()
 {
+    if (m_websocket) {
+        return HandleWebSocketFrames();
+    }
     if (m_buffer_offset == 0) {
         return true;
     }
@@ -324,6 +368,10 @@ bool HttpConnection::HandleRequest()
                     return false;
                 }
                 m_body_size = content_length;
+            } else if (name == "Upgrade") {
+                m_upgrade_websocket = value == "websocket";
+            } else if (name == "Sec-WebSocket-Key") {
+                m_websocket_key = value;
             }
         }
     }
@@ -361,12 +409,36 @@ bool HttpConnection::HandleRequest()
     if (!keep_alive) {
         ShutdownReceive();
         ShutdownTransmit();
+    } else if (m_websocket) {
+        // frames may have arrived right behind the upgrade request
+        return HandleWebSocketFrames();
+    }
+    return true;
+}
+
+/// Finds 'name' in a query string like "a=1&b=2" and parses its value.
+/// Returns true if the parameter is absent, leaving 'output_number' untouched.
+static bool ParseQueryParameter(std::string_view query, std::string_view name, size_t* output_number)
+{
+    while (!query.empty()) {
+        const size_t separator = query.find('&');
+        const std::string_view parameter = query.substr(0, separator);
+        query = separator == std::string_view::npos ? std::string_view() : query.substr(separator + 1);
+        if (parameter.size() > name.size() && parameter.substr(0, name.size()) == name && parameter[name.size()] == '=') {
+            return ParseSizeTFromStringView(parameter.substr(name.size() + 1), output_number, UINT32_MAX);
+        }
     }
     return true;
 }
 
 bool HttpConnection::HandleGET(std::string_view path)
 {
+    std::string_view query;
+    if (const size_t question_mark = path.find('?'); question_mark != std::string_view::npos) {
+        query = path.substr(question_mark + 1);
+        path = path.substr(0, question_mark);
+    }
+
     if (path == "/status") {
         std::string body = m_server->BuildBody(true, false);
         RespondWith("200 OK", body.c_str());
@@ -385,10 +457,17 @@ bool HttpConnection::HandleGET(std::string_view path)
             "data: {}" /* contains implicit newline */
             "\n",
             m_server->BuildBody(true, true));
-        err_t err = tcp_write(m_pcb, msg.c_str(), msg.size(), TCP_WRITE_FLAG_COPY);
+        err_t err = altcp_write(m_pcb, msg.c_str(), msg.size(), TCP_WRITE_FLAG_COPY);
         assert(err == ERR_OK);
         m_server->m_subscribed.emplace_front(this);
         return true;
+    } else if (path == "/history") {
+        return BeginHistory(query);
+    } else if (path == "/metrics") {
+        std::string body = m_server->BuildMetrics();
+        RespondWith("200 OK", body.c_str());
+    } else if (path == "/ws") {
+        return UpgradeToWebSocket();
     } else {
         RespondWith("404 Not Found", R"({"message":"Page not found"})");
     }
@@ -409,9 +488,16 @@ void HttpConnection::HandlePOST(std::string_view path, std::string_view body)
         ArduinoJson::deserializeJson(doc, body);
 
         Mode next_mode = Mode::UNKNOWN;
-        int manual_target = -1;
+        /// -1 leaves the channel's target as it is
+        std::array<int, MOTOR_CHANNELS> manual_targets;
+        manual_targets.fill(-1);
         float static_target = NAN;
         std::array<float, 24> hourly_targets = { NAN };
+        int schedule = -1;
+        bool weekly_set = false;
+        std::array<std::array<uint16_t, 24>, 7> weekly_targets = {};
+        int curve_points = -1;
+        std::array<Flash::Breakpoint, Flash::CURVE_CAPACITY> curve = {};
         uint64_t new_time = UINT64_MAX;
 
         if (std::string_view wanted_mode = doc["wanted_mode"]; !wanted_mode.empty()) {
@@ -436,11 +522,23 @@ void HttpConnection::HandlePOST(std::string_view path, std::string_view body)
                     RespondWith("400 Bad Request", R"({"message": "Invalid manual.target"})");
                     return;
                 }
-                manual_target = target_;
-                if (manual_target < 0) {
-                    manual_target = 0;
-                } else if (manual_target > 100) {
-                    manual_target = 100;
+                // one target moves every curtain
+                manual_targets.fill(std::clamp(target_.as<int>(), 0, 100));
+            }
+            if (ArduinoJson::JsonVariantConst targets_ = manual["targets"]) {
+                // per channel; null leaves a channel at the single target, if any
+                ArduinoJson::JsonArrayConst targets = targets_;
+                bool valid = targets && targets.size() <= manual_targets.size();
+                for (size_t channel = 0; valid && channel < targets.size(); channel++) {
+                    if (targets[channel].isNull()) {
+                        continue;
+                    }
+                    valid = targets[channel].is<int>();
+                    manual_targets[channel] = std::clamp(targets[channel].as<int>(), 0, 100);
+                }
+                if (!valid) {
+                    RespondWith("400 Bad Request", R"({"message": "Invalid manual.targets"})");
+                    return;
                 }
             }
         }
@@ -481,6 +579,50 @@ void HttpConnection::HandlePOST(std::string_view path, std::string_view body)
                     return;
                 }
             }
+            if (std::string_view schedule_ = auto_hourly["schedule"]; !schedule_.empty()) {
+                if (schedule_ == "daily") {
+                    schedule = Flash::sDAILY;
+                } else if (schedule_ == "weekly") {
+                    schedule = Flash::sWEEKLY;
+                } else if (schedule_ == "curve") {
+                    schedule = Flash::sCURVE;
+                } else {
+                    RespondWith("400 Bad Request", R"({"message": "Invalid auto_hourly.schedule"})");
+                    return;
+                }
+            }
+            if (ArduinoJson::JsonVariantConst weekly_ = auto_hourly["weekly"]) {
+                ArduinoJson::JsonArrayConst weekly = weekly_;
+                bool valid = weekly && weekly.size() == weekly_targets.size();
+                for (size_t day = 0; valid && day < weekly_targets.size(); day++) {
+                    ArduinoJson::JsonArrayConst targets = weekly[day];
+                    valid = targets && targets.size() == weekly_targets[day].size();
+                    for (size_t hour = 0; valid && hour < weekly_targets[day].size(); hour++) {
+                        valid = targets[hour].is<uint16_t>();
+                        weekly_targets[day][hour] = targets[hour].as<uint16_t>();
+                    }
+                }
+                if (!valid) {
+                    RespondWith("400 Bad Request", R"({"message": "Invalid auto_hourly.weekly"})");
+                    return;
+                }
+                weekly_set = true;
+            }
+            if (ArduinoJson::JsonVariantConst curve_ = auto_hourly["curve"]) {
+                ArduinoJson::JsonArrayConst points = curve_;
+                bool valid = points && points.size() <= curve.size();
+                for (size_t i = 0; valid && i < points.size(); i++) {
+                    ArduinoJson::JsonArrayConst point = points[i];
+                    valid = point && point.size() == 2 && point[0].is<uint16_t>() && point[1].is<uint16_t>();
+                    curve[i] = { point[0].as<uint16_t>(), point[1].as<uint16_t>() };
+                    valid = valid && curve[i].minute < 24 * 60 && (i == 0 || curve[i].minute > curve[i - 1].minute);
+                }
+                if (!valid) {
+                    RespondWith("400 Bad Request", R"({"message": "Invalid auto_hourly.curve, expected up to 16 [minute, lux] pairs in order"})");
+                    return;
+                }
+                curve_points = static_cast<int>(points.size());
+            }
         }
         if (ArduinoJson::JsonVariantConst time_high = doc["time_high"]; !time_high.isNull()) {
             if (!time_high.is<uint32_t>()) {
@@ -528,7 +670,7 @@ void HttpConnection::HandlePOST(std::string_view path, std::string_view body)
                 return;
             }
         }
-        m_server->m_params.storage->WriteAccessAndProgramLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
+        m_server->m_params.storage->WriteAccessLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
             Mode current_mode = Mode::UNKNOWN;
 
             if (next_mode != Mode::UNKNOWN) {
@@ -561,13 +703,16 @@ void HttpConnection::HandlePOST(std::string_view path, std::string_view body)
                 }
             }
 
-            if (manual_target != -1) {
-                settings.motor_target = static_cast<int8_t>(manual_target);
-                if (current_mode == Mode::MANUAL) {
-                    m_server->m_params.motor_command->Overwrite(Motor::Command(manual_target));
+            for (size_t channel = 0; channel < manual_targets.size(); ++channel) {
+                Motor* motor = m_server->m_params.motors.at(channel);
+                if (manual_targets.at(channel) != -1) {
+                    settings.channels[channel].motor_target = static_cast<int8_t>(manual_targets.at(channel));
+                    if (current_mode == Mode::MANUAL) {
+                        motor->Post(Motor::Command(manual_targets.at(channel)));
+                    }
+                } else if (next_mode == Mode::MANUAL) {
+                    motor->Post(Motor::Command(settings.channels[channel].motor_target));
                 }
-            } else if (next_mode == Mode::MANUAL) {
-                m_server->m_params.motor_command->Overwrite(Motor::Command(settings.motor_target));
             }
 
             if (!std::isnan(static_target)) {
@@ -582,14 +727,357 @@ void HttpConnection::HandlePOST(std::string_view path, std::string_view body)
                     settings.lux_targets[Flash::H00 + i] = hourly_targets.at(i);
                 }
             }
+
+            if (schedule != -1) {
+                settings.schedule = schedule;
+            }
+            if (weekly_set) {
+                static_assert(sizeof(weekly_targets) == sizeof(settings.weekly_targets));
+                memcpy(settings.weekly_targets, weekly_targets.data(), sizeof(settings.weekly_targets));
+            }
+            if (curve_points != -1) {
+                settings.curve_points = curve_points;
+                std::copy(curve.begin(), curve.end(), settings.curve);
+            }
         });
 
         std::string res_body = m_server->BuildBody(false, true);
         RespondWith("200 OK", res_body.c_str());
     } else if (path == "/calibrate") {
-        m_server->m_params.motor_command->Overwrite(Motor::Command::CALIBRATE);
+        for (Motor* motor : m_server->m_params.motors) {
+            motor->Post(Motor::Command::CALIBRATE);
+        }
+        RespondWith("202 Accepted", R"({})");
+    } else if (path.substr(0, 11) == "/calibrate/") {
+        size_t channel = 0;
+        if (!ParseSizeTFromStringView(path.substr(11), &channel) || channel >= m_server->m_params.motors.size()) {
+            RespondWith("404 Not Found", R"({"message":"No such motor channel"})");
+            return;
+        }
+        m_server->m_params.motors.at(channel)->Post(Motor::Command::CALIBRATE);
         RespondWith("202 Accepted", R"({})");
     } else {
         RespondWith("404 Not Found", R"({"message":"Page not found"})");
     }
 }
+
+bool HttpConnection::BeginHistory(std::string_view query)
+{
+    size_t from = 0;
+    size_t to = UINT32_MAX;
+    size_t step = 0;
+    if (!ParseQueryParameter(query, "from", &from) || !ParseQueryParameter(query, "to", &to) || !ParseQueryParameter(query, "step", &step)) {
+        RespondWith("400 Bad Request", R"({"message":"Invalid from, to or step"})");
+        return false;
+    }
+
+    static constexpr std::string_view head = "HTTP/1.1 200 OK\r\n"
+                                             "Connection: close\r\n"
+                                             "Content-Type: application/json\r\n"
+                                             "Transfer-Encoding: chunked\r\n"
+                                             "\r\n";
+    err_t err = altcp_write(m_pcb, head.data(), head.size(), TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE);
+    assert(err == ERR_OK);
+
+    m_history_cursor = m_server->m_params.history->Begin(from, to, step);
+    m_history_first = true;
+    m_chunk_len = 0;
+    m_streaming_history = true;
+    StreamHistory();
+    // the connection is closed by StreamHistory() once everything is sent
+    return true;
+}
+
+void HttpConnection::StreamHistory()
+{
+    /// "XXX\r\n" in front of the chunk data, "\r\n" after it
+    static constexpr size_t CHUNK_HEADER_LEN = 5;
+    static constexpr size_t CHUNK_TRAILER_LEN = 2;
+    /// Largest formatted bucket plus separator, with margin
+    static constexpr size_t BUCKET_MAX_LEN = 224;
+    static constexpr std::string_view END_OF_STREAM = "0\r\n\r\n";
+
+    while (m_pcb != nullptr) {
+        if (m_chunk_len == 0) {
+            char* data = m_chunk.data() + CHUNK_HEADER_LEN;
+            char* const data_start = data;
+            char* const data_end = m_chunk.data() + m_chunk.size() - CHUNK_TRAILER_LEN;
+            if (m_history_first) {
+                *data++ = '[';
+            }
+            while (!m_history_cursor.done && data + BUCKET_MAX_LEN <= data_end) {
+                History::Bucket bucket;
+                if (m_server->m_params.history->Next(&m_history_cursor, &bucket, 1) == 0) {
+                    break;
+                }
+                data = fmt::format_to_n(data, data_end - data,
+                    R"({}{{"t":{},"n":{},"lux":{{"min":{},"max":{},"avg":[{},{}]}},"target":{},"position":{{"min":{},"max":{},"avg":{}}}}})",
+                    m_history_first ? "" : ",", bucket.timestamp, bucket.count,
+                    // -1 where no sensor gave a reading, as in /status
+                    bucket.HasLux() ? bucket.lux_min : -1.0f, bucket.HasLux() ? bucket.lux_max : -1.0f,
+                    bucket.lux1_count != 0 ? bucket.lux1_avg : -1.0f, bucket.lux2_count != 0 ? bucket.lux2_avg : -1.0f,
+                    bucket.target_avg,
+                    bucket.position_min, bucket.position_max, bucket.position_avg)
+                           .out;
+                m_history_first = false;
+            }
+            if (m_history_cursor.done) {
+                *data++ = ']';
+            }
+            const size_t data_len = data - data_start;
+            fmt::format_to_n(m_chunk.data(), CHUNK_HEADER_LEN, "{:03X}\r\n", data_len);
+            *data++ = '\r';
+            *data++ = '\n';
+            m_chunk_len = data - m_chunk.data();
+        }
+
+        if (m_chunk_len > altcp_sndbuf(m_pcb)) {
+            // continued from SentCallback
+            return;
+        }
+        if (altcp_write(m_pcb, m_chunk.data(), m_chunk_len, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+            return;
+        }
+        m_chunk_len = 0;
+
+        if (m_history_cursor.done) {
+            err_t err = altcp_write(m_pcb, END_OF_STREAM.data(), END_OF_STREAM.size(), TCP_WRITE_FLAG_COPY);
+            if (err != ERR_OK) {
+                Logger::Log("HTTP: Could not terminate history stream {}", err);
+            }
+            altcp_output(m_pcb);
+            m_streaming_history = false;
+            ShutdownReceive();
+            ShutdownTransmit();
+            return;
+        }
+        altcp_output(m_pcb);
+    }
+}
+
+void HttpConnection::Push(std::string_view body)
+{
+    if (m_websocket) {
+        WriteWebSocketFrame(WS_OPCODE_TEXT, body);
+        return;
+    }
+    std::string msg = fmt::format("data: {}\n", body);
+    err_t err = altcp_write(m_pcb, msg.c_str(), msg.size(), TCP_WRITE_FLAG_COPY);
+    if (err != ERR_OK) {
+        Logger::Log("tcp_write failed {}", err);
+        return;
+    }
+    altcp_output(m_pcb);
+}
+
+bool HttpConnection::UpgradeToWebSocket()
+{
+    if (!m_upgrade_websocket || m_websocket_key.empty()) {
+        RespondWith("426 Upgrade Required", R"({"message":"Expected a websocket upgrade"})");
+        return false;
+    }
+
+    std::string key { m_websocket_key };
+    key += WEBSOCKET_GUID;
+    std::array<unsigned char, 20> digest = {};
+    std::array<unsigned char, 32> accept = {};
+    size_t accept_len = 0;
+    if (mbedtls_sha1(reinterpret_cast<const unsigned char*>(key.data()), key.size(), digest.data()) != 0
+        || mbedtls_base64_encode(accept.data(), accept.size(), &accept_len, digest.data(), digest.size()) != 0) {
+        RespondWith("500 Internal Server Error", R"({"message":"Websocket handshake failed"})");
+        return false;
+    }
+
+    std::string head = fmt::format(
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: {}\r\n"
+        "\r\n",
+        std::string_view(reinterpret_cast<const char*>(accept.data()), accept_len));
+    err_t err = altcp_write(m_pcb, head.c_str(), head.size(), TCP_WRITE_FLAG_COPY);
+    assert(err == ERR_OK);
+    // Commands are tiny and latency matters more than segment count
+    altcp_nagle_disable(m_pcb);
+
+    m_websocket = true;
+    m_websocket_key = {};
+    WriteWebSocketFrame(WS_OPCODE_TEXT, m_server->BuildBody(true, true));
+    m_server->m_subscribed.emplace_front(this);
+    return true;
+}
+
+bool HttpConnection::HandleWebSocketFrames()
+{
+    while (m_pcb != nullptr && m_buffer_offset >= 2) {
+        auto* frame = reinterpret_cast<uint8_t*>(m_buffer.data());
+        const bool fin = (frame[0] & 0x80) != 0;
+        const uint8_t opcode = frame[0] & 0x0F;
+        const bool masked = (frame[1] & 0x80) != 0;
+        size_t payload_len = frame[1] & 0x7F;
+        size_t header_len = 2;
+        if (payload_len == 126) {
+            if (m_buffer_offset < 4) {
+                return true;
+            }
+            payload_len = static_cast<size_t>(frame[2]) << 8 | frame[3];
+            header_len = 4;
+        } else if (payload_len == 127) {
+            Logger::Log("WS: Frame too big");
+            return false;
+        }
+        if (!masked) {
+            // RFC 6455 5.1: a server MUST close the connection upon receiving an unmasked frame
+            Logger::Log("WS: Unmasked client frame");
+            return false;
+        }
+        if (!fin || opcode == WS_OPCODE_CONTINUATION) {
+            Logger::Log("WS: Fragmented frames are not supported");
+            return false;
+        }
+        const uint8_t* mask = frame + header_len;
+        header_len += 4;
+        const size_t frame_len = header_len + payload_len;
+        if (frame_len > m_buffer.size()) {
+            Logger::Log("WS: Frame too big");
+            return false;
+        }
+        if (frame_len > m_buffer_offset) {
+            // wait for more data
+            return true;
+        }
+
+        char* payload = m_buffer.data() + header_len;
+        for (size_t i = 0; i < payload_len; i++) {
+            payload[i] = static_cast<char>(payload[i] ^ mask[i % 4]);
+        }
+        const std::string_view payload_view = { payload, payload_len };
+
+        switch (opcode) {
+        case WS_OPCODE_TEXT:
+        case WS_OPCODE_BINARY:
+            HandleWebSocketCommand(payload_view);
+            break;
+        case WS_OPCODE_PING:
+            WriteWebSocketFrame(WS_OPCODE_PONG, payload_view);
+            break;
+        case WS_OPCODE_PONG:
+            break;
+        case WS_OPCODE_CLOSE:
+            WriteWebSocketFrame(WS_OPCODE_CLOSE, payload_view.substr(0, 2));
+            ShutdownReceive();
+            ShutdownTransmit();
+            return true;
+        default:
+            Logger::Log("WS: Unknown opcode {}", opcode);
+            return false;
+        }
+
+        memmove(m_buffer.data(), m_buffer.data() + frame_len, m_buffer_offset - frame_len);
+        m_buffer_offset -= frame_len;
+    }
+    return true;
+}
+
+/// Commands:
+///   o       open completely
+///   c       close completely
+///   s       stop
+///   g<0-100> go to position, e.g. "g70" for 70 % closed; "g70.5" goes to 70.5 %
+///   r<steps> go to a step count from the open limit, as in "current_raw"
+/// go to every channel, unless prefixed with one, as in "1:g70"
+void HttpConnection::HandleWebSocketCommand(std::string_view command)
+{
+    size_t first = 0;
+    size_t last = m_server->m_params.motors.size();
+    if (const size_t colon = command.find(':'); colon != std::string_view::npos) {
+        size_t channel = 0;
+        if (!ParseSizeTFromStringView(command.substr(0, colon), &channel) || channel >= last) {
+            WriteWebSocketFrame(WS_OPCODE_TEXT, R"({"message":"Invalid channel"})");
+            return;
+        }
+        first = channel;
+        last = channel + 1;
+        command = command.substr(colon + 1);
+    }
+    if (command.empty()) {
+        return;
+    }
+
+    Motor::Command motor_command = Motor::STOP;
+    switch (command.front()) {
+    case 'o':
+        motor_command = Motor::OPEN_COMPLETELY;
+        break;
+    case 'c':
+        motor_command = Motor::CLOSE_COMPLETELY;
+        break;
+    case 's':
+        motor_command = Motor::STOP;
+        break;
+    case 'g': {
+        const std::string_view number = command.substr(1);
+        const size_t point = number.find('.');
+        size_t target = 0;
+        size_t tenth = 0;
+        if (number.empty() || !ParseSizeTFromStringView(number.substr(0, point), &target) || target > Motor::CLOSE_COMPLETELY
+            || (point != std::string_view::npos
+                && (number.size() != point + 2 || !ParseSizeTFromStringView(number.substr(point + 1), &tenth)
+                    || target * 10 + tenth > Motor::PERMILLE_MAX))) {
+            WriteWebSocketFrame(WS_OPCODE_TEXT, R"({"message":"Invalid target"})");
+            return;
+        }
+        motor_command = point == std::string_view::npos ? Motor::Command(target) : Motor::Permille(target * 10 + tenth);
+        break;
+    }
+    case 'r': {
+        size_t steps = 0;
+        if (command.size() < 2 || !ParseSizeTFromStringView(command.substr(1), &steps, Motor::STEPS_MAX)) {
+            WriteWebSocketFrame(WS_OPCODE_TEXT, R"({"message":"Invalid target"})");
+            return;
+        }
+        motor_command = Motor::Steps(steps);
+        break;
+    }
+    default:
+        WriteWebSocketFrame(WS_OPCODE_TEXT, R"({"message":"Invalid command"})");
+        return;
+    }
+
+    for (size_t channel = first; channel < last; ++channel) {
+        if (m_server->m_params.motors.at(channel)->CurrentCommand() == Motor::CALIBRATE) {
+            WriteWebSocketFrame(WS_OPCODE_TEXT, R"({"message":"Motor currently calibrating, command ignored"})");
+            return;
+        }
+    }
+    // Jogging is not persisted to flash; the settings endpoint does that
+    m_server->m_params.control_auto->Take(0);
+    for (size_t channel = first; channel < last; ++channel) {
+        m_server->m_params.motors.at(channel)->Post(motor_command);
+    }
+}
+
+void HttpConnection::WriteWebSocketFrame(uint8_t opcode, std::string_view payload)
+{
+    std::array<uint8_t, 4> header = {};
+    size_t header_len = 2;
+    header[0] = 0x80 | opcode;
+    if (payload.size() < 126) {
+        header[1] = static_cast<uint8_t>(payload.size());
+    } else {
+        assert(payload.size() <= UINT16_MAX);
+        header[1] = 126;
+        header[2] = static_cast<uint8_t>(payload.size() >> 8);
+        header[3] = static_cast<uint8_t>(payload.size());
+        header_len = 4;
+    }
+    err_t err = altcp_write(m_pcb, header.data(), header_len, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE);
+    if (err == ERR_OK && !payload.empty()) {
+        err = altcp_write(m_pcb, payload.data(), payload.size(), TCP_WRITE_FLAG_COPY);
+    }
+    if (err != ERR_OK) {
+        Logger::Log("WS: tcp_write failed {}", err);
+        return;
+    }
+    altcp_output(m_pcb);
+}
@@ -3,15 +3,18 @@
 #include <array>
 #include <string_view>
 
-#include <lwip/tcp.h>
+#include <lwip/altcp.h>
 #include <picohttpparser.h>
 
+#include "History.hpp"
+
 class HttpServer;
 class HttpConnection {
 public:
     struct ConstructionParameters {
-        tcp_pcb* pcb;
+        altcp_pcb* pcb;
         HttpServer* server;
+        bool tls;
     };
 
     explicit HttpConnection(const ConstructionParameters&);
@@ -35,6 +38,7 @@ private:
     void ErrorCallback(err_t err);
 
     void RespondWith(const char* status, const char* body);
+    void Push(std::string_view body);
     [[nodiscard]] size_t WriteToBuffer(const uint8_t* data, size_t len);
 
     [[nodiscard]] bool HandleRequest();
@@ -42,11 +46,20 @@ private:
     bool HandleGET(std::string_view path);
     void HandlePOST(std::string_view path, std::string_view body);
 
+    bool BeginHistory(std::string_view query);
+    void StreamHistory();
+
+    bool UpgradeToWebSocket();
+    [[nodiscard]] bool HandleWebSocketFrames();
+    void HandleWebSocketCommand(std::string_view command);
+    void WriteWebSocketFrame(uint8_t opcode, std::string_view payload);
+
     HttpServer* m_server;
-    tcp_pcb* m_pcb;
+    altcp_pcb* m_pcb;
     bool m_tx_closed = false;
     bool m_rx_closed = false;
     bool m_discard_inbound = false;
+    bool m_websocket = false;
     std::array<char, 4096> m_buffer = {};
     size_t m_buffer_offset = 0;
     size_t m_parse_last_len = 0;
@@ -58,6 +71,18 @@ private:
     std::array<phr_header, 128> m_headers = {};
     size_t m_headers_size = 0;
     size_t m_body_size = 0;
+    const bool m_tls;
+    /// Set while the TLS handshake of this connection is still running
+    uint32_t m_handshake_start_us = 0;
+    bool m_upgrade_websocket = false;
+    std::string_view m_websocket_key;
+
+    bool m_streaming_history = false;
+    bool m_history_first = true;
+    History::Cursor m_history_cursor = {};
+    /// One chunk of the chunked transfer encoding, kept until the stack accepts it
+    std::array<char, 1024> m_chunk = {};
+    size_t m_chunk_len = 0;
 
     friend HttpServer;
 };
@@ -1,16 +1,69 @@
 #include "HttpServer.hpp"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
 #include <FreeRTOS.h>
+#include <lwip/altcp_tcp.h>
 #include <lwip/autoip.h>
 #include <lwip/dhcp.h>
+#include <lwip/tcpip.h>
 #include <task.h>
 
 #include "HttpConnection.hpp"
 #include "Logger.hpp"
 
+#if HTTPS_ENABLED
+#include <mbedtls/platform.h>
+
+#include "https_credentials.h"
+
+// mbedTLS allocations, counted so /metrics can show what a handshake costs.
+// Only called with the lwIP core locked: from the callbacks, which run under it, and from TaskEntry(), which takes it.
+static size_t s_tls_heap_in_use = 0;
+static size_t s_tls_heap_peak = 0;
+/// Lowest since the last TLS connection closed, so frees lwIP defers past the close still count as idle
+static size_t s_tls_heap_low = 0;
+
+static void* TlsCalloc(size_t count, size_t size)
+{
+    if (size != 0 && count > (SIZE_MAX - sizeof(std::max_align_t)) / size) {
+        return nullptr;
+    }
+    const size_t bytes = count * size;
+    auto* block = static_cast<std::max_align_t*>(calloc(1, sizeof(std::max_align_t) + bytes));
+    if (block == nullptr) {
+        return nullptr;
+    }
+    *reinterpret_cast<size_t*>(block) = bytes;
+    s_tls_heap_in_use += bytes;
+    s_tls_heap_peak = std::max(s_tls_heap_peak, s_tls_heap_in_use);
+    return block + 1;
+}
+
+static void TlsFree(void* pointer)
+{
+    if (pointer == nullptr) {
+        return;
+    }
+    auto* block = static_cast<std::max_align_t*>(pointer) - 1;
+    s_tls_heap_in_use -= *reinterpret_cast<size_t*>(block);
+    s_tls_heap_low = std::min(s_tls_heap_low, s_tls_heap_in_use);
+    free(block);
+}
+#endif
+
 HttpServer::HttpServer(const ConstructionParameters& params)
     : m_pcb(nullptr)
     , m_params(params)
+    , m_subscriber(params.notifier->Subscribe({
+          .name = "HttpNotify",
+          .topics = Notifier::ALL,
+          .min_interval = NOTIFY_MIN_INTERVAL,
+          .max_latency = NOTIFY_MAX_LATENCY,
+      }))
 {
     xTaskCreate(TASK_KONDOM(HttpServer, TaskEntry), "HTTP_SUB", TaskStackSize::HTTP_SUB, this, TaskPriority::HTTP_SUB, nullptr);
 }
@@ -18,42 +71,80 @@ HttpServer::HttpServer(const ConstructionParameters& params)
 HttpServer::~HttpServer()
 {
     if (m_pcb != nullptr) {
-        tcp_close(m_pcb);
+        altcp_close(m_pcb);
+    }
+#if HTTPS_ENABLED
+    if (m_tls_pcb != nullptr) {
+        altcp_close(m_tls_pcb);
+    }
+    if (m_tls_config != nullptr) {
+        altcp_tls_free_config(m_tls_config);
     }
+#endif
 }
 
 bool HttpServer::Listen()
 {
     assert(m_pcb == nullptr);
-    m_pcb = tcp_new();
+    m_pcb = Listen(altcp_tcp_new(), m_params.port, false);
     if (m_pcb == nullptr) {
-        Logger::Log("ERROR: tcp_new() returned null");
         return false;
     }
 
-    err_t err = tcp_bind(m_pcb, IP_ADDR_ANY, m_params.port);
-    if (err != ERR_OK) {
-        Logger::Log("ERROR: tcp_bind() failed");
-        tcp_close(m_pcb);
-        m_pcb = nullptr;
+#if HTTPS_ENABLED
+    assert(m_tls_pcb == nullptr);
+    mbedtls_platform_set_calloc_free(TlsCalloc, TlsFree);
+    m_tls_config = altcp_tls_create_config_server_privkey_cert(
+        reinterpret_cast<const u8_t*>(HTTPS_KEY), sizeof(HTTPS_KEY),
+        nullptr, 0,
+        reinterpret_cast<const u8_t*>(HTTPS_CERT), sizeof(HTTPS_CERT));
+    if (m_tls_config == nullptr) {
+        Logger::Log("ERROR: altcp_tls_create_config_server_privkey_cert() failed");
+        return false;
+    }
+    m_tls_pcb = Listen(altcp_tls_new(m_tls_config, IPADDR_TYPE_ANY), m_params.tls_port, true);
+    if (m_tls_pcb == nullptr) {
         return false;
     }
+    s_tls_heap_low = s_tls_heap_in_use;
+#endif
 
-    tcp_pcb* pcb = tcp_listen(m_pcb);
+    return true;
+}
+
+altcp_pcb* HttpServer::Listen(altcp_pcb* pcb, const uint16_t port, const bool tls)
+{
     if (pcb == nullptr) {
-        Logger::Log("ERROR: tcp_listen() failed");
-        tcp_close(m_pcb);
-        m_pcb = nullptr;
-        return false;
+        Logger::Log("ERROR: altcp_new() returned null");
+        return nullptr;
     }
-    m_pcb = pcb;
 
-    tcp_arg(m_pcb, this);
-    tcp_accept(m_pcb, [](void* arg, struct tcp_pcb* newpcb, err_t err) -> err_t {
-        return static_cast<HttpServer*>(arg)->AcceptCallback(newpcb, err);
-    });
+    err_t err = altcp_bind(pcb, IP_ADDR_ANY, port);
+    if (err != ERR_OK) {
+        Logger::Log("ERROR: altcp_bind() failed on port {}", port);
+        altcp_close(pcb);
+        return nullptr;
+    }
 
-    return true;
+    altcp_pcb* listen_pcb = altcp_listen(pcb);
+    if (listen_pcb == nullptr) {
+        Logger::Log("ERROR: altcp_listen() failed on port {}", port);
+        altcp_close(pcb);
+        return nullptr;
+    }
+
+    altcp_arg(listen_pcb, this);
+    if (tls) {
+        altcp_accept(listen_pcb, [](void* arg, struct altcp_pcb* newpcb, err_t err) -> err_t {
+            return static_cast<HttpServer*>(arg)->AcceptCallback(newpcb, err, true);
+        });
+    } else {
+        altcp_accept(listen_pcb, [](void* arg, struct altcp_pcb* newpcb, err_t err) -> err_t {
+            return static_cast<HttpServer*>(arg)->AcceptCallback(newpcb, err, false);
+        });
+    }
+
+    return listen_pcb;
 }
 
 std::string HttpServer::BuildBody(bool include_status, bool include_settings)
@@ -64,12 +155,11 @@ std::string HttpServer::BuildBody(bool include_status, bool include_settings)
         if (body.size() != 1) {
             body += ',';
         }
-        Motor::Command motor_command;
-        if (!m_params.motor_command->Peek(&motor_command, pdMS_TO_TICKS(100))) {
-            motor_command = Motor::Command::STOP;
-        }
+        const bool calibrating = std::any_of(m_params.motors.begin(), m_params.motors.end(), [](const Motor* motor) {
+            return motor->CurrentCommand() == Motor::Command::CALIBRATE;
+        });
         const char* mode = nullptr;
-        if (motor_command == Motor::Command::CALIBRATE) {
+        if (calibrating) {
             mode = "calibrating";
         } else if (m_params.control_auto->Count() == 0) {
             mode = "manual";
@@ -79,43 +169,20 @@ std::string HttpServer::BuildBody(bool include_status, bool include_settings)
             mode = "auto_hourly";
         }
         fmt::format_to(ins, R"("mode":"{}",)", mode);
-        fmt::format_to(ins, R"("motor":{{)");
-        int motor_pos = m_params.motor->GetBeltPosition();
-        int motor_max = m_params.motor->GetBeltMaximum();
-        if (motor_max == 0) {
-            motor_max = -1;
-        }
-        int motor_percent = motor_pos * 100 / motor_max;
-        int motor_target = -1;
-        if (motor_command == Motor::Command::CALIBRATE) {
-            motor_pos = 0;
-            motor_max = 0;
-            motor_percent = 0;
-            motor_target = 0;
-        } else if (motor_command == Motor::Command::STOP) {
-            if (motor_max == -1) {
-                motor_target = 0;
-            } else {
-                motor_target = motor_percent;
+        // "motor" stays the first channel for clients that know of only one
+        fmt::format_to(ins, R"("motor":)");
+        AppendMotorStatus(body, *m_params.motors.front());
+        body += ',';
+        if (m_params.motors.size() > 1) {
+            fmt::format_to(ins, R"("motors":[)");
+            for (size_t channel = 0; channel < m_params.motors.size(); ++channel) {
+                if (channel != 0) {
+                    body += ',';
+                }
+                AppendMotorStatus(body, *m_params.motors.at(channel));
             }
-        } else if (motor_command == Motor::Command::OPEN) {
-            motor_target = 100;
-        } else if (motor_command == Motor::Command::CLOSE) {
-            motor_target = 0;
-        } else {
-            motor_target = motor_command;
+            fmt::format_to(ins, "],");
         }
-        if (motor_target < 0) {
-            motor_target = 0;
-        } else if (motor_target > 100) {
-            motor_target = 100;
-        }
-        assert(motor_target >= 0 && motor_target <= 100);
-        fmt::format_to(ins, R"("target":{},)", motor_target);
-        fmt::format_to(ins, R"("current":{},)", motor_percent);
-        fmt::format_to(ins, R"("current_raw":{},)", motor_pos);
-        fmt::format_to(ins, R"("length_raw":{})", motor_max);
-        fmt::format_to(ins, "}},");
         fmt::format_to(ins, R"("lux":{{)");
         float lux_target = 0.0f;
         if (!m_params.lux_target->Peek(&lux_target, pdMS_TO_TICKS(100))) {
@@ -153,26 +220,46 @@ std::string HttpServer::BuildBody(bool include_status, bool include_settings)
             body += ',';
         }
         const char* mode = "unknown";
-        int manual_target = 0;
+        std::array<int, MOTOR_CHANNELS> manual_targets = {};
         std::array<float, 25> auto_targets = { 0 };
-        m_params.storage->ReadOnlyAccessLocked(portMAX_DELAY,
-            [&](const Flash::Settings& settings) -> void {
-                if (settings.sys_mode & Flash::bAUTO) {
-                    if (settings.sys_mode & Flash::bAUTO_HOURLY) {
-                        mode = "auto_hourly";
-                    } else {
-                        mode = "auto_static";
-                    }
+        Flash::Schedule schedule = Flash::sDAILY;
+        std::array<std::array<uint16_t, 24>, 7> weekly_targets = {};
+        std::array<Flash::Breakpoint, Flash::CURVE_CAPACITY> curve = {};
+        size_t curve_points = 0;
+        m_params.storage->ReadOnlyAccess([&](const Flash::Settings& settings) -> void {
+            if (settings.sys_mode & Flash::bAUTO) {
+                if (settings.sys_mode & Flash::bAUTO_HOURLY) {
+                    mode = "auto_hourly";
                 } else {
-                    mode = "manual";
+                    mode = "auto_static";
                 }
-                manual_target = +settings.motor_target;
-                static_assert(sizeof(auto_targets) == sizeof(settings.lux_targets));
-                memcpy(auto_targets.data(), settings.lux_targets, auto_targets.size() * sizeof(float));
-            });
+            } else {
+                mode = "manual";
+            }
+            for (size_t channel = 0; channel < manual_targets.size(); ++channel) {
+                manual_targets.at(channel) = +settings.channels[channel].motor_target;
+            }
+            static_assert(sizeof(auto_targets) == sizeof(settings.lux_targets));
+            memcpy(auto_targets.data(), settings.lux_targets, auto_targets.size() * sizeof(float));
+            schedule = static_cast<Flash::Schedule>(settings.schedule);
+            static_assert(sizeof(weekly_targets) == sizeof(settings.weekly_targets));
+            memcpy(weekly_targets.data(), settings.weekly_targets, sizeof(settings.weekly_targets));
+            curve_points = std::min<size_t>(settings.curve_points, curve.size());
+            std::copy(settings.curve, settings.curve + curve_points, curve.begin());
+        });
         fmt::format_to(ins, R"("wanted_mode":"{}",)", mode);
         fmt::format_to(ins, R"("manual":{{)");
-        fmt::format_to(ins, R"("target":{})", manual_target);
+        fmt::format_to(ins, R"("target":{})", manual_targets.front());
+        if (manual_targets.size() > 1) {
+            fmt::format_to(ins, R"(,"targets":[)");
+            for (size_t channel = 0; channel < manual_targets.size(); ++channel) {
+                if (channel != 0) {
+                    body += ',';
+                }
+                fmt::format_to(ins, R"({})", manual_targets.at(channel));
+            }
+            body += ']';
+        }
         fmt::format_to(ins, "}},");
         fmt::format_to(ins, R"("auto_static":{{"target":{}}},)", auto_targets[Flash::LUX_STATIC]);
         fmt::format_to(ins, R"("auto_hourly":{{"targets":[)");
@@ -182,16 +269,160 @@ std::string HttpServer::BuildBody(bool include_status, bool include_settings)
             }
             fmt::format_to(ins, R"({})", auto_targets.at(Flash::H00 + i));
         }
-        fmt::format_to(ins, "]}}");
+        fmt::format_to(ins, "]");
+        // only the schedule in use, to keep subscription events small
+        if (schedule == Flash::sWEEKLY) {
+            fmt::format_to(ins, R"(,"schedule":"weekly","weekly":[)");
+            for (size_t day = 0; day < weekly_targets.size(); day++) {
+                if (day != 0) {
+                    body += ',';
+                }
+                body += '[';
+                for (size_t hour = 0; hour < weekly_targets[day].size(); hour++) {
+                    if (hour != 0) {
+                        body += ',';
+                    }
+                    fmt::format_to(ins, R"({})", weekly_targets[day][hour]);
+                }
+                body += ']';
+            }
+            body += ']';
+        } else if (schedule == Flash::sCURVE) {
+            fmt::format_to(ins, R"(,"schedule":"curve","curve":[)");
+            for (size_t i = 0; i < curve_points; i++) {
+                if (i != 0) {
+                    body += ',';
+                }
+                fmt::format_to(ins, R"([{},{}])", curve[i].minute, curve[i].lux);
+            }
+            body += ']';
+        } else {
+            fmt::format_to(ins, R"(,"schedule":"daily")");
+        }
+        fmt::format_to(ins, "}}");
     }
     body.append("}\n");
     return body;
 }
 
-err_t HttpServer::AcceptCallback(struct tcp_pcb* newpcb, err_t err)
+void HttpServer::AppendMotorStatus(std::string& body, const Motor& motor)
+{
+    auto ins = std::back_inserter(body);
+    const Motor::Command motor_command = motor.CurrentCommand();
+    fmt::format_to(ins, "{{");
+    const Motor::Position position = motor.GetPosition();
+    int motor_pos = position.steps;
+    int motor_max = position.max;
+    if (motor_max == 0) {
+        motor_max = -1;
+    }
+    int motor_percent = motor_pos * 100 / motor_max;
+    int motor_target = -1;
+    int motor_target_raw = -1;
+    if (motor_command == Motor::Command::CALIBRATE) {
+        motor_pos = 0;
+        motor_max = 0;
+        motor_percent = 0;
+        motor_target = 0;
+    } else if (motor_command == Motor::Command::STOP) {
+        if (motor_max == -1) {
+            motor_target = 0;
+        } else {
+            motor_target = motor_percent;
+        }
+    } else if (motor_command == Motor::Command::OPEN) {
+        motor_target = 100;
+    } else if (motor_command == Motor::Command::CLOSE) {
+        motor_target = 0;
+    } else if (motor_command <= Motor::CLOSE_COMPLETELY || motor_max == -1) {
+        motor_target = motor_command;
+    } else {
+        motor_target_raw = Motor::TargetSteps(motor_command, motor_max);
+        motor_target = (motor_target_raw * 100 + motor_max / 2) / motor_max;
+    }
+    if (motor_target < 0) {
+        motor_target = 0;
+    } else if (motor_target > 100) {
+        motor_target = 100;
+    }
+    assert(motor_target >= 0 && motor_target <= 100);
+    fmt::format_to(ins, R"("target":{},)", motor_target);
+    if (motor_target_raw >= 0) {
+        // sub-percent targets
+        fmt::format_to(ins, R"("target_raw":{},)", motor_target_raw);
+    }
+    fmt::format_to(ins, R"("current":{},)", motor_percent);
+    fmt::format_to(ins, R"("current_raw":{},)", motor_pos);
+    fmt::format_to(ins, R"("length_raw":{})", motor_max);
+    fmt::format_to(ins, "}}");
+}
+
+std::string HttpServer::BuildMetrics() const
+{
+    const auto subscribers = std::distance(m_subscribed.begin(), m_subscribed.end());
+    std::string body = "{";
+    auto ins = std::back_inserter(body);
+    fmt::format_to(ins, R"("heap":{{"total":{},"free":{},"min_free":{}}},)",
+        configTOTAL_HEAP_SIZE, xPortGetFreeHeapSize(), xPortGetMinimumEverFreeHeapSize());
+    const Flash::Statistics flash = m_params.storage->GetStatistics();
+    fmt::format_to(ins, R"("flash":{{"records":{},"skipped":{},"erases":{},"last_program_us":{}}},)",
+        flash.records, flash.skipped, flash.erases, flash.last_program_us);
+    fmt::format_to(ins, R"("drift":[)");
+    for (size_t channel = 0; channel < m_params.motors.size(); ++channel) {
+        if (channel != 0) {
+            body += ',';
+        }
+        const Motor::DriftStatistics drift = m_params.motors.at(channel)->GetDriftStatistics();
+        fmt::format_to(ins, R"({{"contacts":{},"corrected":{},"recalibrations":{},"last":{},"worst":{},"mean":{}}})",
+            drift.contacts, drift.corrected, drift.recalibrations, drift.last_error, drift.worst_error,
+            drift.contacts == 0 ? 0 : drift.total_error / drift.contacts);
+    }
+    fmt::format_to(ins, "],");
+#if HTTPS_ENABLED
+    fmt::format_to(ins, R"("tls":{{"handshakes":{},"last_us":{},"max_us":{},"last_heap":{},"max_heap":{},"heap_in_use":{}}},)",
+        m_tls_statistics.handshakes, m_tls_statistics.last_us, m_tls_statistics.max_us,
+        m_tls_statistics.last_heap, m_tls_statistics.max_heap, s_tls_heap_in_use);
+#endif
+    fmt::format_to(ins, R"("subscribers":{})", subscribers);
+    body.append("}\n");
+    return body;
+}
+
+#if HTTPS_ENABLED
+void HttpServer::OpenTls()
+{
+    if (m_tls_connections++ == 0) {
+        // lwIP set up this connection's context before accepting it, so the window starts there
+        m_tls_idle_heap = s_tls_heap_low;
+        s_tls_heap_peak = s_tls_heap_in_use;
+    }
+}
+
+void HttpServer::RecordTlsHandshake(uint32_t duration_us)
+{
+    const size_t heap = s_tls_heap_peak - std::min(s_tls_heap_peak, m_tls_idle_heap);
+    m_tls_statistics.handshakes++;
+    m_tls_statistics.last_us = duration_us;
+    m_tls_statistics.max_us = std::max(m_tls_statistics.max_us, duration_us);
+    m_tls_statistics.last_heap = heap;
+    m_tls_statistics.max_heap = std::max(m_tls_statistics.max_heap, heap);
+}
+
+void HttpServer::CloseTls()
+{
+    assert(m_tls_connections > 0);
+    if (--m_tls_connections == 0) {
+        s_tls_heap_low = s_tls_heap_in_use;
+    }
+}
+#endif
+
+err_t HttpServer::AcceptCallback(struct altcp_pcb* newpcb, err_t err, bool tls)
 {
     if (err != ERR_OK) {
-        tcp_abort(newpcb);
+        if (newpcb != nullptr) {
+            altcp_abort(newpcb);
+        }
         return ERR_ABRT;
     }
 
@@ -199,6 +430,7 @@ err_t HttpServer::AcceptCallback(struct tcp_pcb* newpcb, err_t err)
     new HttpConnection(HttpConnection::ConstructionParameters {
         .pcb = newpcb,
         .server = this,
+        .tls = tls,
     });
 
     return ERR_OK;
@@ -207,20 +439,25 @@ err_t HttpServer::AcceptCallback(struct tcp_pcb* newpcb, err_t err)
 void HttpServer::TaskEntry()
 {
     while (true) {
-        m_params.notify->Take(pdMS_TO_TICKS(5000));
-        if (m_subscribed.empty()) {
+        const Notifier::Topics topics = m_subscriber->Wait(NOTIFY_KEEPALIVE);
+        // the callbacks run in whichever task holds the core lock, and change the subscribers and their connections
+        LOCK_TCPIP_CORE();
+        const bool subscribed = !m_subscribed.empty();
+        UNLOCK_TCPIP_CORE();
+        if (!subscribed) {
             continue;
         }
-        std::string msg = fmt::format("data: {}\n", BuildBody(true, true));
+        // nothing changed within the keepalive period -> resend everything
+        const bool include_status = topics == 0 || (topics & (Notifier::bMOTOR | Notifier::bLUX | Notifier::bMODE)) != 0;
+        const bool include_settings = topics == 0 || (topics & (Notifier::bSETTINGS | Notifier::bMODE)) != 0;
+        const std::string body = BuildBody(include_status, include_settings);
+        LOCK_TCPIP_CORE();
         for (HttpConnection* conn : m_subscribed) {
             if (conn->m_pcb == nullptr) {
                 continue;
             }
-
-            err_t err = tcp_write(conn->m_pcb, msg.c_str(), msg.size(), TCP_WRITE_FLAG_COPY);
-            if (err != ERR_OK) {
-                Logger::Log("tcp_write failed {}", err);
-            }
+            conn->Push(body);
         }
+        UNLOCK_TCPIP_CORE();
     }
 }
@@ -2,27 +2,45 @@
 
 #include <forward_list>
 
-#include <lwip/tcp.h>
+#include <lwip/altcp.h>
+#include <lwip/altcp_tls.h>
 #include <picohttpparser.h>
 
 #include "AmbientLightSensor.hpp"
+#include "History.hpp"
 #include "Motor.hpp"
+#include "Notifier.hpp"
 #include "Storage.hpp"
 
 class HttpConnection;
 class HttpServer {
 public:
+#if HTTPS_ENABLED
+    /// TLS handshakes, timed from the accept to the first decrypted byte, which includes the client's last flight
+    struct TlsStatistics {
+        uint32_t handshakes = 0;
+        uint32_t last_us = 0;
+        uint32_t max_us = 0;
+        /// Peak mbedTLS heap while the connection was set up, above what the listener holds while idle.
+        /// Exact when connections come one at a time, overlapping ones are counted together.
+        size_t last_heap = 0;
+        size_t max_heap = 0;
+    };
+#endif
+
     struct ConstructionParameters {
         uint16_t port;
-        const Motor* motor;
+        /// only used when built with HTTPS_CERT_FILE and HTTPS_KEY_FILE
+        uint16_t tls_port;
+        MotorChannels motors;
         RTOS::Variable<LuxMeasurement>* als1;
         RTOS::Variable<LuxMeasurement>* als2;
-        RTOS::Semaphore* notify;
-        RTOS::Variable<Motor::Command>* motor_command;
+        Notifier* notifier;
         RTOS::Variable<float>* lux_target;
         RTOS::Semaphore* control_auto;
         RTOS::Semaphore* auto_hourly;
         Storage* storage;
+        History* history;
         RTC* rtc;
     };
 
@@ -37,13 +55,34 @@ public:
 
     bool Listen();
     std::string BuildBody(bool include_status, bool include_settings);
+    std::string BuildMetrics() const;
 
 private:
-    err_t AcceptCallback(struct tcp_pcb* newpcb, err_t err);
+    /// One "motor" object of the status
+    static void AppendMotorStatus(std::string& body, const Motor& motor);
+    altcp_pcb* Listen(altcp_pcb* pcb, uint16_t port, bool tls);
+    err_t AcceptCallback(struct altcp_pcb* newpcb, err_t err, bool tls);
+#if HTTPS_ENABLED
+    void OpenTls();
+    void RecordTlsHandshake(uint32_t duration_us);
+    void CloseTls();
+#endif
     void TaskEntry();
 
-    struct tcp_pcb* m_pcb;
+    static constexpr TickType_t NOTIFY_MIN_INTERVAL = pdMS_TO_TICKS(250);
+    static constexpr TickType_t NOTIFY_MAX_LATENCY = pdMS_TO_TICKS(1000);
+    static constexpr TickType_t NOTIFY_KEEPALIVE = pdMS_TO_TICKS(5000);
+
+    struct altcp_pcb* m_pcb;
+#if HTTPS_ENABLED
+    struct altcp_pcb* m_tls_pcb = nullptr;
+    struct altcp_tls_config* m_tls_config = nullptr;
+    TlsStatistics m_tls_statistics;
+    size_t m_tls_connections = 0;
+    size_t m_tls_idle_heap = 0;
+#endif
     const ConstructionParameters m_params;
+    Notifier::Subscriber* m_subscriber;
     std::forward_list<HttpConnection*> m_subscribed;
     friend HttpConnection;
 };
@@ -0,0 +1,85 @@
+#include "LuxSchedule.hpp"
+
+#include <algorithm>
+
+size_t LuxSchedule::Compile(const Flash::Settings& settings, const int8_t dotw)
+{
+    std::array<Knot, MAX_KNOTS> knots;
+    const size_t count = CollectKnots(settings, dotw, knots.data());
+    size_t rewritten = 0;
+    for (size_t i = 0; i + 1 < count; ++i) {
+        const bool unchanged = i + 1 < m_knot_count && knots[i] == m_knots[i] && knots[i + 1] == m_knots[i + 1];
+        if (!unchanged) {
+            Fill(knots[i], knots[i + 1]);
+            rewritten += knots[i + 1].minute - knots[i].minute;
+        }
+    }
+    m_knots = knots;
+    m_knot_count = count;
+    m_day = dotw;
+    return rewritten;
+}
+
+float LuxSchedule::TargetAt(const int8_t hour, const int8_t minute) const
+{
+    const size_t index = std::clamp<int>(hour * 60 + minute, 0, MINUTES_PER_DAY - 1);
+    return static_cast<float>(m_table[index]) / (1 << FRACTION_BITS);
+}
+
+size_t LuxSchedule::CollectKnots(const Flash::Settings& settings, const int8_t dotw, Knot* knots)
+{
+    if (settings.schedule == Flash::sCURVE && settings.curve_points != 0) {
+        size_t count = 1;
+        for (size_t i = 0; i < std::min<size_t>(settings.curve_points, Flash::CURVE_CAPACITY); ++i) {
+            const Flash::Breakpoint& point = settings.curve[i];
+            // out of order breakpoints are dropped rather than guessed at
+            if (point.minute < MINUTES_PER_DAY && (count == 1 || point.minute > knots[count - 1].minute)) {
+                knots[count++] = { point.minute, ToFixed(point.lux) };
+            }
+        }
+        if (count == 1) {
+            return CollectHourlyKnots(settings, dotw, knots);
+        }
+        // the curve wraps around midnight, from the last breakpoint to the first one of the next day
+        const Knot& first = knots[1];
+        const Knot& last = knots[count - 1];
+        const int32_t span = first.minute + MINUTES_PER_DAY - last.minute;
+        const int32_t midnight = last.value + (first.value - last.value) * static_cast<int32_t>(MINUTES_PER_DAY - last.minute) / span;
+        knots[0] = { 0, static_cast<uint16_t>(midnight) };
+        if (first.minute == 0) {
+            std::copy(knots + 1, knots + count, knots);
+            --count;
+        }
+        knots[count++] = { MINUTES_PER_DAY, knots[0].value };
+        return count;
+    }
+    return CollectHourlyKnots(settings, dotw, knots);
+}
+
+size_t LuxSchedule::CollectHourlyKnots(const Flash::Settings& settings, const int8_t dotw, Knot* knots)
+{
+    const size_t day = dotw >= 0 && dotw < 7 ? dotw : 0;
+    for (size_t hour = Flash::H00; hour <= Flash::H23; ++hour) {
+        const float lux = settings.schedule == Flash::sWEEKLY ? settings.weekly_targets[day][hour] : settings.lux_targets[hour];
+        knots[hour] = { static_cast<uint16_t>(hour * 60), ToFixed(lux) };
+    }
+    // the last hour leads into the first one of the next day
+    const float midnight = settings.schedule == Flash::sWEEKLY ? settings.weekly_targets[(day + 1) % 7][Flash::H00] : settings.lux_targets[Flash::H00];
+    knots[24] = { MINUTES_PER_DAY, ToFixed(midnight) };
+    return 25;
+}
+
+uint16_t LuxSchedule::ToFixed(const float lux)
+{
+    static constexpr float MAX = static_cast<float>(UINT16_MAX) / (1 << FRACTION_BITS);
+    return static_cast<uint16_t>(std::clamp(lux, 0.0f, MAX) * (1 << FRACTION_BITS) + 0.5f);
+}
+
+void LuxSchedule::Fill(const Knot& from, const Knot& to)
+{
+    const int32_t span = to.minute - from.minute;
+    const int32_t delta = to.value - from.value;
+    for (int32_t offset = 0; offset < span; ++offset) {
+        m_table[from.minute + offset] = static_cast<uint16_t>(from.value + delta * offset / span);
+    }
+}
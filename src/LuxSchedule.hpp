@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "Flash.hpp"
+
+/// Lux targets for every minute of one day, compiled from the schedule in the settings.
+/// A target is a single table read; Compile() only rewrites the stretches of the table
+/// between knots that actually moved.
+class LuxSchedule {
+public:
+    static constexpr size_t MINUTES_PER_DAY = 24 * 60;
+    /// Table entries are whole lux, so the table spans the full 0 - 65535 lux a BH1750 reports.
+    /// Weekly and curve targets are whole lux anyway; daily targets round to the nearest lux.
+    static constexpr uint32_t FRACTION_BITS = 0;
+
+    /// Prepares the table for 'dotw' (0 is Sunday). Returns the number of entries rewritten.
+    size_t Compile(const Flash::Settings& settings, int8_t dotw);
+    [[nodiscard]] float TargetAt(int8_t hour, int8_t minute) const;
+    /// Day of the week the table was compiled for, -1 before the first Compile()
+    [[nodiscard]] int8_t Day() const { return m_day; }
+
+private:
+    struct Knot {
+        uint16_t minute;
+        uint16_t value;
+
+        [[nodiscard]] bool operator==(const Knot& other) const { return minute == other.minute && value == other.value; }
+    };
+    /// Hourly schedules use 25 knots, curves up to CURVE_CAPACITY plus both ends of the day
+    static constexpr size_t MAX_KNOTS = std::max<size_t>(25, Flash::CURVE_CAPACITY + 2);
+
+    static size_t CollectKnots(const Flash::Settings& settings, int8_t dotw, Knot* knots);
+    static size_t CollectHourlyKnots(const Flash::Settings& settings, int8_t dotw, Knot* knots);
+    [[nodiscard]] static uint16_t ToFixed(float lux);
+    void Fill(const Knot& from, const Knot& to);
+
+    std::array<uint16_t, MINUTES_PER_DAY> m_table = {};
+    std::array<Knot, MAX_KNOTS> m_knots = {};
+    size_t m_knot_count = 0;
+    int8_t m_day = -1;
+};
@@ -0,0 +1,55 @@
+#include "MotionPlanner.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void MotionPlanner::Begin(const Profile& profile)
+{
+    m_profile = profile;
+    m_profile.max_speed = std::max(profile.max_speed, profile.start_speed);
+    m_speed = m_profile.start_speed;
+    m_acceleration = 0;
+}
+
+MotionPlanner::Segment MotionPlanner::Next(const uint32_t remaining, const uint32_t creep)
+{
+    const float speed = m_speed;
+    // the ramps are planned for the move up to where the creep begins
+    const uint32_t planned = remaining > creep ? remaining - creep : 0;
+    const auto steps = std::clamp<uint32_t>(static_cast<uint32_t>(std::lround(speed * SEGMENT_S)), 1, planned > 0 ? planned : remaining);
+    const float duration = static_cast<float>(steps) / speed;
+
+    float wanted = 0;
+    if (planned <= steps + BrakingSteps()) {
+        wanted = -m_profile.acceleration;
+    } else if (speed < m_profile.max_speed) {
+        wanted = m_profile.acceleration;
+    }
+    if (m_profile.jerk > 0) {
+        const float change = m_profile.jerk * duration;
+        m_acceleration = std::clamp(wanted, m_acceleration - change, m_acceleration + change);
+    } else {
+        m_acceleration = wanted;
+    }
+    m_speed = std::clamp(speed + m_acceleration * duration, m_profile.start_speed, m_profile.max_speed);
+    if ((m_speed == m_profile.max_speed && m_acceleration > 0) || (m_speed == m_profile.start_speed && m_acceleration < 0)) {
+        m_acceleration = 0;
+    }
+
+    return { steps, static_cast<uint32_t>(1'000'000.0f / speed) };
+}
+
+uint32_t MotionPlanner::BrakingSteps() const
+{
+    if (m_speed <= m_profile.start_speed) {
+        // already there; the jerk term below would otherwise keep a stop from ever running dry
+        return 0;
+    }
+    const float speed_change = m_speed * m_speed - m_profile.start_speed * m_profile.start_speed;
+    float steps = speed_change / (2 * m_profile.acceleration);
+    if (m_profile.jerk > 0) {
+        // while the acceleration swings round to full deceleration the speed hardly drops
+        steps += m_speed * (m_acceleration + m_profile.acceleration) / m_profile.jerk;
+    }
+    return static_cast<uint32_t>(std::ceil(steps));
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+/// Turns a move into segments of equally spaced steps that accelerate from a start speed the
+/// motor can always pull in, cruise, and slow down again in time for the end of the move.
+/// With jerk 0 the speed follows a trapezoid; otherwise acceleration itself is ramped (S-curve).
+/// Plain arithmetic only, so the same code runs in tools/motion_sim.cpp on a host.
+class MotionPlanner {
+public:
+    struct Profile {
+        float start_speed; /// steps/s, also the speed a move ends at
+        float max_speed; /// steps/s
+        float acceleration; /// steps/s²
+        float jerk; /// steps/s³, 0 for a trapezoid
+    };
+
+    struct Segment {
+        uint32_t steps;
+        uint32_t period_us;
+    };
+
+    /// Each segment lasts about this long, so speed changes in steps of acceleration * SEGMENT_S
+    static constexpr float SEGMENT_S = 0.004f;
+
+    /// Starts a move from standstill
+    void Begin(const Profile& profile);
+    /// The next segment of a move that has 'remaining' > 0 steps left to plan, the last 'creep' of
+    /// them at the start speed
+    Segment Next(uint32_t remaining, uint32_t creep = 0);
+    /// Steps it takes from the current speed down to the start speed
+    [[nodiscard]] uint32_t BrakingSteps() const;
+    [[nodiscard]] float Speed() const { return m_speed; }
+
+private:
+    Profile m_profile = {};
+    float m_speed = 0;
+    float m_acceleration = 0;
+};
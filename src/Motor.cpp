@@ -1,6 +1,10 @@
 #include "Motor.hpp"
 
-#include <hardware/gpio.h>
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
+#include <hardware/timer.h>
 #include <task.h>
 
 #include "Logger.hpp"
@@ -9,35 +13,23 @@
 constexpr bool DIRECTION_CW = true;
 constexpr bool DIRECTION_CCW = false;
 
-constexpr uint STEP_HIGH_MS = 1;
-constexpr uint STEP_LOW_MS = 1;
-
 Motor::Motor(const Parameters& parameters)
-    : m_pin_step(static_cast<uint>(parameters.step))
-    , m_pin_direction(static_cast<uint>(parameters.direction))
-    , m_pin_limit_cw(static_cast<uint>(parameters.limit_cw))
-    , m_pin_limit_ccw(static_cast<uint>(parameters.limit_ccw))
+    : m_channel(parameters.channel)
+    , m_io(parameters.io)
     , m_previous_direction(DIRECTION_CW)
-    , m_v_command(parameters.v_command)
+    , m_move_profile(parameters.move_profile)
+    , m_calibration_profile(parameters.calibration_profile)
     , m_s_control_auto(parameters.s_control_auto)
     , m_v_belt_position(parameters.v_belt_position)
-    , m_s_notify(parameters.s_http_notify)
+    , m_notifier(parameters.notifier)
     , m_storage(parameters.storage)
+    , m_journal(parameters.journal)
     , m_red(parameters.red)
 {
-    gpio_init(m_pin_step);
-    gpio_set_dir(m_pin_step, GPIO_OUT);
-
-    gpio_init(m_pin_direction);
-    gpio_set_dir(m_pin_direction, GPIO_OUT);
-
-    gpio_init(m_pin_limit_cw);
-    gpio_set_dir(m_pin_limit_cw, GPIO_IN);
-    gpio_pull_up(m_pin_limit_cw);
-
-    gpio_init(m_pin_limit_ccw);
-    gpio_set_dir(m_pin_limit_ccw, GPIO_IN);
-    gpio_pull_up(m_pin_limit_ccw);
+    m_io->SetLimitHandler([](void* context, const MotorIO::Limit limit, const bool pressed, BaseType_t* woken) {
+        static_cast<Motor*>(context)->OnLimitSwitchEdge(limit, pressed, woken);
+    },
+        this);
 
     if (xTaskCreate(
             TASK_KONDOM(Motor, Task),
@@ -52,7 +44,89 @@ Motor::Motor(const Parameters& parameters)
         Logger::Log("Error: Failed to created task [{}]", parameters.name);
     }
     m_s_control_auto->Take(0);
-    m_v_command->Overwrite(CALIBRATE);
+    Post(CALIBRATE);
+}
+
+Motor::Sequence Motor::Post(const Command command, const TaskHandle_t issuer)
+{
+    taskENTER_CRITICAL();
+    const bool replacing = m_mail_pending.load(std::memory_order_relaxed);
+    const Mail replaced = m_mailbox;
+    const Sequence sequence = m_next_sequence++;
+    m_mailbox = { .command = command, .sequence = sequence, .issuer = issuer };
+    m_mail_pending.store(true, std::memory_order_release);
+    taskEXIT_CRITICAL();
+    if (replacing && replaced.issuer != nullptr) {
+        // never started, so it is over already
+        xTaskNotifyIndexed(replaced.issuer, TaskNotificationIndex::MOTOR + m_channel, replaced.sequence, eSetValueWithOverwrite);
+    }
+    xTaskNotify(m_handle, bCOMMAND, eSetBits);
+    return sequence;
+}
+
+Motor::Command Motor::CurrentCommand() const
+{
+    taskENTER_CRITICAL();
+    const Command command = m_mail_pending.load(std::memory_order_relaxed) ? m_mailbox.command : m_command;
+    taskEXIT_CRITICAL();
+    return command;
+}
+
+bool Motor::WaitForCompletion(const Sequence sequence, const TickType_t timeout) const
+{
+    const TickType_t start = xTaskGetTickCount();
+    TickType_t wait = 0;
+    while (true) {
+        // the value is the latest sequence of this task's commands to be over, kept until overwritten
+        uint32_t over = 0;
+        xTaskNotifyWaitIndexed(TaskNotificationIndex::MOTOR + m_channel, 0, 0, &over, wait);
+        if (static_cast<int32_t>(over - sequence) >= 0) {
+            return true;
+        }
+        const TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            return false;
+        }
+        wait = timeout == portMAX_DELAY ? portMAX_DELAY : timeout - elapsed;
+    }
+}
+
+bool Motor::TakeCommand()
+{
+    if (!m_mail_pending.load(std::memory_order_acquire)) {
+        return false;
+    }
+    const Sequence preempted = m_sequence;
+    const TaskHandle_t preempted_issuer = m_issuer;
+    taskENTER_CRITICAL();
+    m_command = m_mailbox.command;
+    m_sequence = m_mailbox.sequence;
+    m_issuer = m_mailbox.issuer;
+    m_mail_pending.store(false, std::memory_order_relaxed);
+    taskEXIT_CRITICAL();
+    if (preempted_issuer != nullptr) {
+        xTaskNotifyIndexed(preempted_issuer, TaskNotificationIndex::MOTOR + m_channel, preempted, eSetValueWithOverwrite);
+    }
+    // resolved once; Drive() brakes first if the new target lies the other way
+    const int previous_target = m_target_steps;
+    m_target_steps = TargetSteps(m_command, m_belt_max);
+    // a motion taken over never begins again, so the journal would restore towards the old target
+    const bool moves_on = m_command == OPEN || m_command == CLOSE || IsTarget(m_command);
+    if (m_moving && moves_on && m_target_steps != previous_target) {
+        m_journal->Retarget(m_channel, m_belt_position, m_target_steps);
+    }
+    return true;
+}
+
+void Motor::CompleteCommand()
+{
+    if (m_issuer != nullptr) {
+        xTaskNotifyIndexed(m_issuer, TaskNotificationIndex::MOTOR + m_channel, m_sequence, eSetValueWithOverwrite);
+    }
+    taskENTER_CRITICAL();
+    m_command = STOP;
+    m_issuer = nullptr;
+    taskEXIT_CRITICAL();
 }
 
 std::string Motor::CommandString(const Motor::Command cmd)
@@ -66,73 +140,267 @@ std::string Motor::CommandString(const Motor::Command cmd)
         return "OPEN";
     case CLOSE:
         return "CLOSE";
+    case STOP:
+        return "STOP";
     case CALIBRATE:
         return "CALIBRATE";
     default:
         if (OPEN_COMPLETELY < cmd && cmd < CLOSE_COMPLETELY) {
-            return fmt::format("{}%", static_cast<uint8_t>(cmd));
+            return fmt::format("{}%", static_cast<uint16_t>(cmd));
+        }
+        if (PERMILLE <= cmd && cmd <= PERMILLE + PERMILLE_MAX) {
+            return fmt::format("{}.{}%", (cmd - PERMILLE) / 10, (cmd - PERMILLE) % 10);
+        }
+        if (cmd >= STEPS) {
+            return fmt::format("{} steps", cmd - STEPS);
         }
     }
     return "UNKNOWN";
 }
 
-/// RIGHT
-bool Motor::IsCWLimitSwitchPressed() const
+bool Motor::IsTarget(const Command command)
 {
-    return !gpio_get(m_pin_limit_cw);
+    return command <= CLOSE_COMPLETELY || (PERMILLE <= command && command <= PERMILLE + PERMILLE_MAX) || command >= STEPS;
 }
 
-/// LEFT
-bool Motor::IsCCWLimitSwitchPressed() const
+int Motor::TargetSteps(const Command command, const int belt_max)
 {
-    return !gpio_get(m_pin_limit_ccw);
+    switch (command) {
+    case OPEN:
+        return 0;
+    case CLOSE:
+        return belt_max;
+    default:
+        if (command >= STEPS) {
+            return std::min<int>(command - STEPS, belt_max);
+        }
+        if (command >= PERMILLE) {
+            return (command - PERMILLE) * belt_max / PERMILLE_MAX;
+        }
+        return command * belt_max / 100;
+    }
 }
 
-/// RIGHT
-bool Motor::StepCW() // NOLINT(readability-make-member-function-const)
+void Motor::OnLimitSwitchEdge(const MotorIO::Limit limit, const bool pressed, BaseType_t* woken)
 {
-    if (IsCWLimitSwitchPressed()) {
-        return false;
+    const uint32_t now = time_us_32();
+    uint32_t& previous = m_limit_edge_us.at(limit == MotorIO::Limit::CW ? 0 : 1);
+    const bool bounce = now - previous < LIMIT_DEBOUNCE_US;
+    previous = now;
+    if (bounce || !pressed || limit != m_armed_limit.load(std::memory_order_relaxed)) {
+        return;
+    }
+    // the steps stop on the one the switch closed at; Abort() reads the count later
+    m_io->Freeze();
+    m_armed_limit.store(MotorIO::Limit::NONE, std::memory_order_relaxed);
+    m_limit_tripped.store(true, std::memory_order_release);
+    xTaskNotifyFromISR(m_handle, bLIMIT, eSetBits, woken);
+}
+
+void Motor::ArmLimitSwitch(const bool direction)
+{
+    m_armed_limit.store(direction == DIRECTION_CW ? MotorIO::Limit::CW : MotorIO::Limit::CCW, std::memory_order_relaxed);
+}
+
+/// CW is RIGHT, CCW LEFT
+bool Motor::IsLimitSwitchPressed(const bool direction) const
+{
+    return m_io->IsLimitPressed(direction == DIRECTION_CW ? MotorIO::Limit::CW : MotorIO::Limit::CCW);
+}
+
+Motor::Progress Motor::Drive(const bool direction, const int max_steps, const MotionPlanner::Profile& profile, const int creep)
+{
+    if (direction != m_previous_direction && !m_io->Idle()) {
+        // slow down before turning around
+        return { Brake(), false };
     }
-    gpio_put(m_pin_direction, DIRECTION_CW);
-    if (m_previous_direction == DIRECTION_CCW) {
-        vTaskDelay(1);
+    if (m_io->Idle()) {
+        // nothing was moving, so a trip from standing still means nothing
+        m_limit_tripped.store(false, std::memory_order_relaxed);
     }
-    xTaskDelayUntil(&m_step_finished, STEP_LOW_MS);
-    gpio_put(m_pin_step, true);
-    vTaskDelay(pdMS_TO_TICKS(STEP_HIGH_MS));
-    gpio_put(m_pin_step, false);
-    m_step_finished = xTaskGetTickCount();
-    m_previous_direction = DIRECTION_CW;
-    return true;
+    // armed before looking at the switch, so a press in between still trips it
+    ArmLimitSwitch(direction);
+    if (IsLimitSwitchPressed(direction)) {
+        return { Halt(), true };
+    }
+    if (m_io->Idle()) {
+        m_io->SetDirection(direction);
+        if (direction != m_previous_direction) {
+            vTaskDelay(1);
+        }
+        m_previous_direction = direction;
+        m_planner.Begin(profile);
+    }
+    Feed(max_steps, creep);
+    return Await();
 }
 
-/// LEFT
-bool Motor::StepCCW() // NOLINT(readability-make-member-function-const)
+void Motor::Feed(const int max_steps, const int creep)
 {
-    if (IsCCWLimitSwitchPressed()) {
-        return false;
+    while (!m_io->Full() && static_cast<int>(m_io->Pending()) < max_steps) {
+        const MotionPlanner::Segment segment = m_planner.Next(max_steps - m_io->Pending(), std::max(creep, 0));
+        if (!m_io->Push({ segment.steps, segment.period_us })) {
+            // Full() said there was room; whatever changed its mind, leave it to the next tick
+            break;
+        }
+    }
+}
+
+Motor::Progress Motor::Await()
+{
+    // a posted command or a tripped limit switch ends the wait early
+    xTaskNotifyWait(0, bCOMMAND | bLIMIT, nullptr, 1);
+    const int steps = Account(m_io->Collect());
+    // only the interrupt sets it and only while armed, which it then is not, so no trip is lost in between
+    if (m_limit_tripped.load(std::memory_order_acquire)) {
+        m_limit_tripped.store(false, std::memory_order_relaxed);
+        return { steps + Halt(), true };
     }
-    gpio_put(m_pin_direction, DIRECTION_CCW);
-    if (m_previous_direction == DIRECTION_CW) {
-        vTaskDelay(1);
+    return { steps, false };
+}
+
+int Motor::Brake()
+{
+    Feed(static_cast<int>(m_io->Pending() + m_planner.BrakingSteps()));
+    return Await().steps;
+}
+
+void Motor::Stop()
+{
+    while (!m_io->Idle()) {
+        Brake();
     }
-    xTaskDelayUntil(&m_step_finished, STEP_LOW_MS);
-    gpio_put(m_pin_step, true);
-    vTaskDelay(pdMS_TO_TICKS(STEP_HIGH_MS));
-    gpio_put(m_pin_step, false);
-    m_step_finished = xTaskGetTickCount();
-    m_previous_direction = DIRECTION_CCW;
-    return true;
+}
+
+int Motor::Halt()
+{
+    return Account(m_io->Abort());
+}
+
+int Motor::Account(const uint32_t steps)
+{
+    m_belt_position += m_previous_direction == DIRECTION_CW ? -static_cast<int>(steps) : static_cast<int>(steps);
+    StorePosition();
+    return static_cast<int>(steps);
+}
+
+void Motor::StorePosition()
+{
+    const auto steps = static_cast<uint16_t>(static_cast<int16_t>(m_belt_position));
+    m_position_snapshot.store(steps | static_cast<uint32_t>(m_belt_max) << 16, std::memory_order_relaxed);
+}
+
+Motor::Position Motor::GetPosition() const
+{
+    const uint32_t snapshot = m_position_snapshot.load(std::memory_order_relaxed);
+    return { .steps = static_cast<int16_t>(snapshot & 0xFFFF), .max = static_cast<int>(snapshot >> 16) };
+}
+
+void Motor::PublishPosition(const bool final)
+{
+    StorePosition();
+    const TickType_t now = xTaskGetTickCount();
+    if (m_belt_max == 0 || (!final && now - m_published_at < POSITION_PUBLISH_INTERVAL)) {
+        return;
+    }
+    const uint8_t percent = BeltPosition();
+    if (percent == m_published_percent) {
+        return;
+    }
+    m_published_percent = percent;
+    m_published_at = now;
+    if (m_v_belt_position != nullptr) {
+        m_v_belt_position->Overwrite(percent);
+    }
+    if (!final) {
+        m_notifier->Publish(Notifier::bMOTOR);
+    }
+}
+
+int Motor::RunToLimit(const bool direction, const int max_steps)
+{
+    int steps = 0;
+    while (steps <= max_steps) {
+        const Progress progress = Drive(direction, max_steps + 1 - steps, m_calibration_profile);
+        steps += progress.steps;
+        if (progress.limit) {
+            return steps;
+        }
+    }
+    return -1;
+}
+
+int Motor::Home(const bool direction, const int expected, const int tolerance)
+{
+    const int start = m_belt_position;
+    const auto travelled = [&] { return std::abs(m_belt_position - start); };
+    // where the switch is expected, the move goes on into the window at the start speed instead of stopping short of it
+    const int limit = expected > 0 ? expected + tolerance : OUT_OF_BOUNDS_CLOSE;
+    const int creep = expected > 0 ? std::min(limit, 2 * tolerance) : 0;
+    bool hit = false;
+    while (!hit && travelled() < limit) {
+        hit = Drive(direction, limit - travelled(), m_move_profile, creep).limit;
+    }
+    if (!hit) {
+        return -1;
+    }
+    if (expected > 0 && travelled() >= limit - creep) {
+        return travelled();
+    }
+    // the switch was hit at speed, or was closed to begin with; back off until it opens and feel for it again slowly.
+    // Running into the other switch instead means both read closed, and no amount of backing off opens this one
+    const int backoff_start = m_belt_position;
+    const auto backed_off = [&] { return std::abs(m_belt_position - backoff_start); };
+    while (backed_off() < HOMING_BACKOFF_STEPS) {
+        if (Drive(!direction, HOMING_BACKOFF_STEPS - backed_off(), m_move_profile).limit) {
+            return -1;
+        }
+    }
+    while (IsLimitSwitchPressed(direction)) {
+        if (backed_off() > OUT_OF_BOUNDS_CLOSE || Drive(!direction, HOMING_BACKOFF_STEPS, m_calibration_profile).limit) {
+            Stop();
+            return -1;
+        }
+    }
+    Stop();
+    if (RunToLimit(direction, backed_off() + HOMING_BACKOFF_STEPS) < 0) {
+        return -1;
+    }
+    return travelled();
 }
 
 void Motor::Task()
 {
     Logger::Log("Initiated");
+    m_storage->ReadOnlyAccess([&](const Flash::Settings& settings) {
+        const Flash::Channel& channel = settings.channels[m_channel];
+        m_belt_max = channel.belt_max;
+        m_belt_position = std::min<int>(channel.belt_position, channel.belt_max);
+    });
+    const PositionJournal::Estimate estimate = m_journal->Restore(m_channel);
+    switch (estimate.state) {
+    case PositionJournal::State::EMPTY:
+        break;
+    case PositionJournal::State::LOST:
+        m_belt_max = 0;
+        break;
+    case PositionJournal::State::STOPPED:
+    case PositionJournal::State::MOVING:
+        m_belt_position = std::clamp(estimate.position, 0, m_belt_max);
+        // percentage targets only resolve to within a percent of the belt
+        m_position_uncertainty = estimate.uncertainty + (estimate.state == PositionJournal::State::MOVING ? m_belt_max / 100 : 0);
+        break;
+    }
+    PublishPosition(true);
+    m_restore_calibration = m_belt_max != 0;
     while (true) {
-        m_v_command->Peek(&m_command, portMAX_DELAY);
+        // a posted command takes over at the step boundary of this tick
+        if (!TakeCommand() && m_command == STOP) {
+            xTaskNotifyWait(0, bCOMMAND | bLIMIT, nullptr, portMAX_DELAY);
+            continue;
+        }
         if (m_belt_max == 0 && m_command != CALIBRATE) {
-            Logger::Log("Warning: Uncalibrated. Retracting command [{}]. Switching to manual.", static_cast<uint8_t>(m_command));
+            Logger::Log("Warning: Uncalibrated. Retracting command [{}]. Switching to manual.", CommandString(m_command));
             m_s_control_auto->Take(0);
             ConcludeCommand();
             continue;
@@ -141,13 +409,13 @@ void Motor::Task()
         case OPEN_COMPLETELY:
         case OPEN:
             if (!Open()) {
-                m_belt_max = 0;
+                Recalibrate();
             }
             break;
         case CLOSE_COMPLETELY:
         case CLOSE:
             if (!Close()) {
-                m_belt_max = 0;
+                Recalibrate();
             }
             break;
         case STOP:
@@ -155,7 +423,7 @@ void Motor::Task()
             break;
         case CALIBRATE:
             if (!Calibrate()) {
-                m_belt_max = 0;
+                InvalidateCalibration();
                 m_red->On();
             }
             ConcludeCommand();
@@ -164,13 +432,13 @@ void Motor::Task()
             }
             break;
         default:
-            if (OPEN_COMPLETELY < m_command && m_command < CLOSE_COMPLETELY) {
+            if (IsTarget(m_command)) {
                 if (!MoveTo()) {
-                    m_belt_max = 0;
+                    Recalibrate();
                 }
             } else {
-                Logger::Log("Error: Unknown action command: {}", static_cast<uint8_t>(m_command));
-                m_v_command->Receive(&m_command, 0);
+                Logger::Log("Error: Unknown action command: {}", static_cast<uint16_t>(m_command));
+                CompleteCommand();
             }
         }
     }
@@ -179,164 +447,227 @@ void Motor::Task()
 bool Motor::Calibrate()
 {
     Logger::Log("Calibrating...");
-    m_s_notify->Give();
-    m_belt_position = 0;
-    while (StepCW()) {
-        if (++m_belt_position > OUT_OF_BOUNDS_CLOSE) {
-            Logger::Log("Warning: CALIBRATE: CW LimitSW not found");
-            return false;
-        }
+    m_notifier->Publish(Notifier::bMOTOR | Notifier::bMODE);
+    // concluding the calibration journals the position it ends at
+    m_journal->Invalidate(m_channel);
+    Stop();
+    m_moving = true;
+    if (std::exchange(m_restore_calibration, false) && VerifyCalibration()) {
+        return true;
+    }
+    const TickType_t start = xTaskGetTickCount();
+    if (Home(DIRECTION_CW, 0, 0) < 0) {
+        Logger::Log("Warning: CALIBRATE: CW LimitSW not found");
+        return false;
     }
     m_belt_position = 0;
-    while (StepCCW()) {
-        if (++m_belt_position > OUT_OF_BOUNDS_CLOSE) {
-            Logger::Log("Warning: CALIBRATE: CCW LimitSW not found");
-            return false;
-        }
+    if (Home(DIRECTION_CCW, 0, 0) < 0) {
+        Logger::Log("Warning: CALIBRATE: CCW LimitSW not found");
+        return false;
     }
     m_belt_max = m_belt_position;
-    m_v_belt_position->Overwrite(BeltPosition());
-    Logger::Log("Calibrated. Max steps: {}", m_belt_max);
+    PublishPosition(true);
+    Logger::Log("Calibrated. Max steps: {} ({} ms)", m_belt_max, (xTaskGetTickCount() - start) * portTICK_PERIOD_MS);
+    return true;
+}
+
+bool Motor::VerifyCalibration()
+{
+    const int tolerance = DriftTolerance() + m_position_uncertainty;
+    const bool towards_open = m_belt_position <= m_belt_max / 2;
+    const int expected = towards_open ? m_belt_position : m_belt_max - m_belt_position;
+    Logger::Log("Verifying stored calibration: {} / {}. Expecting {} limit in {} +- {} steps",
+        m_belt_position, m_belt_max, towards_open ? "open" : "closed", expected, tolerance);
+    const int steps = Home(towards_open ? DIRECTION_CW : DIRECTION_CCW, expected, tolerance);
+    if (steps < 0) {
+        Logger::Log("Warning: Limit not found within tolerance. Recalibrating");
+        return false;
+    }
+    if (steps < expected - tolerance) {
+        Logger::Log("Warning: Limit found after only {} steps. Recalibrating", steps);
+        return false;
+    }
+    m_belt_position = towards_open ? 0 : m_belt_max;
+    PublishPosition(true);
+    Logger::Log("Calibration verified. Off by {} steps", steps - expected);
+    return true;
+}
+
+void Motor::SaveCalibration()
+{
+    m_storage->WriteAccessLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
+        settings.channels[m_channel].belt_max = m_belt_max;
+        settings.channels[m_channel].belt_position = std::clamp(m_belt_position, 0, m_belt_max);
+    });
+}
+
+void Motor::InvalidateCalibration()
+{
+    m_belt_max = 0;
+    m_moving = false;
+    StorePosition();
+    m_journal->Invalidate(m_channel);
+    SaveCalibration();
+}
+
+void Motor::Recalibrate()
+{
+    Logger::Log("Warning: Position lost. Recalibrating");
+    InvalidateCalibration();
+    // given back by PermitAutomaticControl() once calibrated, as at boot
+    m_s_control_auto->Take(0);
+    // posted first, so the issuer told of the end of its command never sees the motor idle
+    Post(CALIBRATE);
+    ConcludeCommand();
+}
+
+bool Motor::CheckLimit(const bool direction)
+{
+    const int expected = direction == DIRECTION_CW ? 0 : m_belt_max;
+    const int error = m_belt_position - expected;
+    const int tolerance = DriftTolerance();
+    RecordDrift(error, std::abs(error) > tolerance);
+    if (std::abs(error) > tolerance) {
+        Logger::Log("Warning: {} limit switch {} steps off, tolerating {}", direction == DIRECTION_CW ? "Open" : "Closed", error, tolerance);
+        return false;
+    }
+    if (error != 0) {
+        // missed steps and belt slip only ever build up, so the switch is the better guess
+        Logger::Log("{} limit switch {} steps off. Position corrected", direction == DIRECTION_CW ? "Open" : "Closed", error);
+        m_belt_position = expected;
+        StorePosition();
+    }
     return true;
 }
 
+void Motor::RecordDrift(const int error, const bool recalibrate)
+{
+    taskENTER_CRITICAL();
+    ++m_drift.contacts;
+    if (recalibrate) {
+        ++m_drift.recalibrations;
+    } else if (error != 0) {
+        ++m_drift.corrected;
+    }
+    m_drift.last_error = error;
+    if (std::abs(error) > std::abs(m_drift.worst_error)) {
+        m_drift.worst_error = error;
+    }
+    m_drift.total_error += std::abs(error);
+    taskEXIT_CRITICAL();
+}
+
+Motor::DriftStatistics Motor::GetDriftStatistics() const
+{
+    taskENTER_CRITICAL();
+    const DriftStatistics drift = m_drift;
+    taskEXIT_CRITICAL();
+    return drift;
+}
+
 bool Motor::Open()
 {
-    if (!StepCW()) {
+    // the switch is due within the tolerance either side of 0, and that stretch is covered at the start speed
+    const int tolerance = DriftTolerance();
+    const int limit = m_belt_position + tolerance;
+    const Progress progress = Drive(DIRECTION_CW, limit, m_move_profile, std::min(limit, 2 * tolerance));
+    if (progress.steps != 0) {
+        PublishPosition(false);
+        JournalStep();
+    }
+    if (progress.limit) {
+        if (!CheckLimit(DIRECTION_CW)) {
+            return false;
+        }
         ConcludeCommand();
-    } else if (m_belt_position < OUT_OF_BOUNDS_OPEN) {
-        Logger::Log("Warning: OPEN out of bounds: {} / {}", m_belt_position, m_belt_max);
+    } else if (m_belt_position <= -tolerance) {
+        Halt();
+        Logger::Log("Warning: OPEN passed the open limit switch by {} steps without hitting it", -m_belt_position);
+        RecordDrift(m_belt_position, true);
         return false;
-    } else {
-        --m_belt_position;
-        m_v_belt_position->Overwrite(BeltPosition());
     }
     return true;
 }
 
 bool Motor::Close()
 {
-    if (!StepCCW()) {
+    const int tolerance = DriftTolerance();
+    const int limit = m_belt_max - m_belt_position + tolerance;
+    const Progress progress = Drive(DIRECTION_CCW, limit, m_move_profile, std::min(limit, 2 * tolerance));
+    if (progress.steps != 0) {
+        PublishPosition(false);
+        JournalStep();
+    }
+    if (progress.limit) {
+        if (!CheckLimit(DIRECTION_CCW)) {
+            return false;
+        }
         ConcludeCommand();
-    } else if (m_belt_position > OUT_OF_BOUNDS_CLOSE) {
-        Logger::Log("Warning: CLOSE out of bounds: {} / {}", m_belt_position, m_belt_max);
+    } else if (m_belt_position >= m_belt_max + tolerance) {
+        Halt();
+        Logger::Log("Warning: CLOSE passed the closed limit switch by {} steps without hitting it", m_belt_position - m_belt_max);
+        RecordDrift(m_belt_position - m_belt_max, true);
         return false;
-    } else {
-        ++m_belt_position;
-        m_v_belt_position->Overwrite(BeltPosition());
     }
     return true;
 }
 
 bool Motor::MoveTo()
 {
-    const auto current_position = BeltPosition();
-    if (current_position < m_command) {
-        return Close();
+    const int remaining = m_target_steps - m_belt_position;
+    if (remaining == 0) {
+        Logger::Log("Position reached: ~{} % ; {} / {} ", BeltPosition(), m_belt_position, m_belt_max);
+        ConcludeCommand();
+        return true;
     }
-    if (current_position > m_command) {
-        return Open();
+    const bool direction = remaining < 0 ? DIRECTION_CW : DIRECTION_CCW;
+    const Progress progress = Drive(direction, std::abs(remaining), m_move_profile);
+    if (progress.steps != 0) {
+        PublishPosition(false);
+        JournalStep();
+    }
+    if (progress.limit) {
+        Logger::Log("Warning: Limit switch hit before reaching {}", CommandString(m_command));
+        // corrected, the target lies back the other way, or here
+        return CheckLimit(direction);
     }
-    Logger::Log("Position reached: ~{} % ; {} / {} ", current_position, m_belt_position, m_belt_max);
-    ConcludeCommand();
     return true;
 }
 
 void Motor::ConcludeCommand()
 {
+    Stop();
     const Command command = m_command;
-    // remove the command to signal pertinent tasks that motor has concluded the command
-    m_v_command->Receive(&m_command, 0);
-    if (command != m_command) {
-        // if command changed during command execution
-        // put it back
-        m_v_command->Append(m_command, 0);
+    CompleteCommand();
+    if (m_belt_max != 0) {
+        if (std::exchange(m_moving, false)) {
+            m_journal->EndMotion(m_channel, m_belt_position);
+        }
+        SaveCalibration();
+    }
+    PublishPosition(true);
+    m_notifier->Publish(command == CALIBRATE ? Notifier::bMOTOR | Notifier::bMODE : Notifier::bMOTOR);
+}
+
+void Motor::JournalStep()
+{
+    if (m_moving) {
+        m_journal->Step(m_channel, m_belt_position);
+    } else {
+        m_moving = true;
+        m_journal->BeginMotion(m_channel, m_belt_position, m_target_steps);
     }
-    m_s_notify->Give();
 }
 
 void Motor::PermitAutomaticControl()
 {
-    m_storage->ReadOnlyAccessLocked(portMAX_DELAY, [&](const Flash::Settings& settings) {
+    m_storage->ReadOnlyAccess([&](const Flash::Settings& settings) {
         if (settings.sys_mode & Flash::bAUTO) {
             m_s_control_auto->Give();
             Logger::Log("Control mode permitted to AUTO");
         } else {
-            m_v_command->Overwrite(Command { settings.motor_target });
-            Logger::Log("Control mode MANUAL. Target {} %", settings.motor_target);
+            Post(Command { settings.channels[m_channel].motor_target });
+            Logger::Log("Control mode MANUAL. Target {} %", settings.channels[m_channel].motor_target);
         }
     });
 }
-
-/// TODO: remove
-
-void test_motor_commands_task(void* params)
-{
-    auto* cmd = static_cast<test_params*>(params)->cmd;
-    auto* control_auto = static_cast<test_params*>(params)->control_auto;
-    auto* target = static_cast<test_params*>(params)->target;
-
-    Logger::Log("Waiting for initial {} to finish", Motor::CommandString(Motor::Command::CALIBRATE));
-    control_auto->Take(portMAX_DELAY);
-    Logger::Log("Finished initial {}", Motor::CommandString(Motor::Command::CALIBRATE));
-    vTaskDelay(pdMS_TO_TICKS(10000));
-
-    auto new_command = Motor::Command { 50 };
-    cmd->Append(new_command, portMAX_DELAY);
-    Logger::Log("Commanded to {}", Motor::CommandString(new_command));
-
-    vTaskDelay(pdMS_TO_TICKS(15000));
-    auto prev_command = new_command;
-    new_command = Motor::CLOSE_COMPLETELY;
-    cmd->Overwrite(new_command);
-    Logger::Log("Overwrote {} command to {}", Motor::CommandString(prev_command), Motor::CommandString(new_command));
-    vTaskDelay(pdMS_TO_TICKS(10000));
-
-    new_command = Motor::Command { 75 };
-    cmd->Append(new_command, portMAX_DELAY);
-    Logger::Log("Commanded to {}", Motor::CommandString(new_command));
-
-    Logger::Log("Waiting for {} to finish...", Motor::CommandString(new_command));
-    cmd->Append(Motor::STOP, portMAX_DELAY);
-    Logger::Log("Finished {}", Motor::CommandString(new_command));
-    vTaskDelay(pdMS_TO_TICKS(10000));
-
-    new_command = Motor::Command::OPEN_COMPLETELY;
-    cmd->Append(new_command, portMAX_DELAY);
-    Logger::Log("Commanded to {}", Motor::CommandString(new_command));
-
-    Logger::Log("Waiting for {} to finish...", Motor::CommandString(new_command));
-    cmd->Append(Motor::STOP, portMAX_DELAY);
-    Logger::Log("Finished {}", Motor::CommandString(new_command));
-    vTaskDelay(pdMS_TO_TICKS(10000));
-
-    new_command = Motor::Command::CALIBRATE;
-    cmd->Append(new_command, portMAX_DELAY);
-    Logger::Log("Commanded to {}", Motor::CommandString(new_command));
-
-    Logger::Log("Waiting for {} to finish...", Motor::CommandString(new_command));
-    cmd->Append(Motor::STOP, portMAX_DELAY);
-    Logger::Log("Finished {}", Motor::CommandString(new_command));
-    vTaskDelay(pdMS_TO_TICKS(10000));
-
-    control_auto->Give();
-    Logger::Log("Manual -> Auto");
-
-    float new_target = 200;
-    target->Overwrite(new_target);
-    Logger::Log("Setting lux target to: {}", new_target);
-
-    vTaskDelay(pdMS_TO_TICKS(15000));
-    new_target = 100;
-    target->Overwrite(new_target);
-    Logger::Log("Setting lux target to: {}", new_target);
-
-    Logger::Log("Done");
-    vTaskDelay(portMAX_DELAY);
-}
-
-void test_motor_commands(const test_params& params)
-{
-    auto* p = new test_params(params);
-    xTaskCreate(test_motor_commands_task, "TestMotor", DEFAULT_TASK_STACK_SIZE * 4, p, tskIDLE_PRIORITY + 4, nullptr);
-}
@@ -1,30 +1,23 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
 #include "Indicator.hpp"
+#include "MotionPlanner.hpp"
+#include "MotorIO.hpp"
+#include "Notifier.hpp"
+#include "PositionJournal.hpp"
 #include "Queue.hpp"
 #include "Semaphore.hpp"
 #include "Storage.hpp"
-
-// Assuming pinout
-//  1. Step
-//  2. Direction
-//  3. Limit switch CW
-//  4. Limit switch CCW
-//  5. NC
-//  6. NC
-//  7. GND
-//  8. 3V3
-//  9. NC
-// 10. NC
+#include "config.h"
 
 class Motor {
 public:
-    enum class PinStep : uint { };
-    enum class PinDirection : uint { };
-    enum class PinLimitCW : uint { };
-    enum class PinLimitCCW : uint { };
-
-    enum Command : uint8_t {
+    enum Command : uint16_t {
         OPEN_COMPLETELY = 0,
         /// Numbers here inbetween [0 - 100] represent a percentage:
         /// Command { 30 } means the curtain will be adjusted to ~30% closed / ~70 % open
@@ -33,86 +26,216 @@ public:
         CLOSE = 102,
         STOP = 103,
         CALIBRATE = 104,
+        /// PERMILLE + [0 - 1000] is a target in tenths of a percent, see Permille()
+        PERMILLE = 0x1000,
+        /// STEPS + n is a target n steps from the open limit, see Steps()
+        STEPS = 0x8000,
     };
+    static constexpr int PERMILLE_MAX = 1000;
+    static constexpr int STEPS_MAX = 0x7FFF;
 
     struct Parameters {
         const char* name;
+        /// Selects the Settings::channels entry, the journal track and the MOTOR + channel notification index
+        uint8_t channel;
+
+        /// MotorGPIO, or a SimulatedBelt to run without the hardware
+        MotorIO* io;
 
-        PinStep step;
-        PinDirection direction;
-        PinLimitCW limit_cw;
-        PinLimitCCW limit_ccw;
+        MotionPlanner::Profile move_profile;
+        /// Runs into the limit switches, so usually slower
+        MotionPlanner::Profile calibration_profile;
 
-        RTOS::Variable<Command>* v_command;
         RTOS::Semaphore* s_control_auto;
+        /// Only channel 0 has its position kept in the history; nullptr for the others
         RTOS::Variable<uint8_t>* v_belt_position;
-        RTOS::Semaphore* s_http_notify;
+        Notifier* notifier;
 
         Storage* storage;
+        PositionJournal* journal;
         Indicator* red;
     };
 
+    using Sequence = uint32_t;
+
     explicit Motor(const Parameters& parameters);
     [[nodiscard]] static std::string CommandString(Motor::Command cmd);
 
-    [[nodiscard]] int GetBeltPosition() const
-    {
-        return m_belt_position;
-    }
+    /// Hands 'command' to the motor task, which drops whatever it is doing for it at its next step
+    /// boundary. Once the command is over, by concluding or by being replaced in turn, 'issuer' gets
+    /// the returned sequence number as its MOTOR + channel task notification; see WaitForCompletion().
+    Sequence Post(Command command, TaskHandle_t issuer = nullptr);
+    /// The command being carried out or about to be, STOP when idle
+    [[nodiscard]] Command CurrentCommand() const;
+    /// Waits until the calling task's command 'sequence' is over. Returns false on timeout.
+    bool WaitForCompletion(Sequence sequence, TickType_t timeout) const;
+    [[nodiscard]] static Command Permille(uint16_t permille) { return Command(PERMILLE + std::min<int>(permille, PERMILLE_MAX)); }
+    [[nodiscard]] static Command Steps(uint16_t steps) { return Command(STEPS + std::min<int>(steps, STEPS_MAX)); }
+    /// Commands that move to a position: percentages, permille and steps
+    [[nodiscard]] static bool IsTarget(Command command);
+    /// Absolute step count a target command moves to on a belt of 'belt_max' steps
+    [[nodiscard]] static int TargetSteps(Command command, int belt_max);
+
+    struct Position {
+        int steps;
+        int max; /// 0 while uncalibrated
+    };
 
-    [[nodiscard]] int GetBeltMaximum() const
-    {
-        return m_belt_max;
-    }
+    /// Position as of the motor task's last tick. Lock-free, so any task may poll it.
+    [[nodiscard]] Position GetPosition() const;
+
+    /// How far off the position was whenever a limit switch closed while calibrated
+    struct DriftStatistics {
+        uint32_t contacts;
+        uint32_t corrected; /// off, but within tolerance, so the position was set to the switch
+        uint32_t recalibrations; /// off by more than the tolerance, or an end passed without its switch
+        int last_error; /// steps; positive when the belt was thought to be further closed than it is
+        int worst_error;
+        uint32_t total_error; /// sum of the absolute errors, for the mean
+    };
+    [[nodiscard]] DriftStatistics GetDriftStatistics() const;
+    [[nodiscard]] uint8_t Channel() const { return m_channel; }
 
 private:
-    [[nodiscard]] bool IsCWLimitSwitchPressed() const;
-    [[nodiscard]] bool IsCCWLimitSwitchPressed() const;
+    /// What one tick of Drive() did
+    struct Progress {
+        int steps;
+        bool limit; /// the limit switch in the direction of travel is pressed
+    };
 
-    bool StepCW();
-    bool StepCCW();
+    void OnLimitSwitchEdge(MotorIO::Limit limit, bool pressed, BaseType_t* woken);
+    /// Lets the limit switch in 'direction' stop the step generator
+    void ArmLimitSwitch(bool direction);
+
+    [[nodiscard]] bool IsLimitSwitchPressed(bool direction) const;
+
+    /// Keeps the step generator fed for up to 'max_steps' more steps, counting those already queued,
+    /// the last 'creep' of them at the start speed, then waits a tick and accounts the steps taken in
+    /// m_belt_position. Going the other way than the steps still queued brakes first.
+    Progress Drive(bool direction, int max_steps, const MotionPlanner::Profile& profile, int creep = 0);
+    void Feed(int max_steps, int creep = 0);
+    /// Waits a tick, or until the armed limit switch trips, and accounts the steps taken
+    Progress Await();
+    /// One tick of slowing down to the start speed; returns the steps taken
+    int Brake();
+    /// Brakes until the step generator runs dry
+    void Stop();
+    /// Stops the step generator at once and accounts the steps it took
+    int Halt();
+    /// Steps until the limit switch is hit; -1 if it was not within 'max_steps'
+    int RunToLimit(bool direction, int max_steps);
+    /// Stops right where the limit switch in 'direction' closes and returns how far that was, or -1.
+    /// An 'expected' distance runs at full speed until 'tolerance' short of it and on at the start
+    /// speed without stopping; a switch hit any sooner, or without an 'expected' distance, is backed
+    /// off from and approached again slowly. -1 as well if backing off runs into the other switch.
+    int Home(bool direction, int expected, int tolerance);
+    int Account(uint32_t steps);
+    void StorePosition();
+    /// Stores the position and, if its rounded percentage changed, hands it to v_belt_position and
+    /// the notifier, at most once per POSITION_PUBLISH_INTERVAL. A 'final' position is handed over
+    /// at once and without a notification, as the caller publishes bMOTOR itself.
+    void PublishPosition(bool final);
+
+    /// Reasons to wake the motor task, as bits of its notification value
+    enum Event : uint32_t {
+        bCOMMAND = 0b01,
+        bLIMIT = 0b10,
+    };
+
+    struct Mail {
+        Command command;
+        Sequence sequence;
+        TaskHandle_t issuer;
+    };
+
+    /// Switches to a posted command, telling the issuer of the one it replaces. False if none was posted.
+    bool TakeCommand();
+    /// Tells the issuer the current command is over and goes idle
+    void CompleteCommand();
 
     void Task();
 
     bool Calibrate();
+    bool VerifyCalibration();
+    void SaveCalibration();
+    void InvalidateCalibration();
+    /// Drops the calibration and calibrates again; the automatic control gets the motor back after
+    void Recalibrate();
+    /// Compares the position with where the limit switch in 'direction', now closed, should be.
+    /// Drift within DriftTolerance() is corrected; beyond it false, as the calibration is off.
+    bool CheckLimit(bool direction);
+    /// Adds a contact 'error' steps off to the statistics
+    void RecordDrift(int error, bool recalibrate);
+    [[nodiscard]] int DriftTolerance() const { return m_belt_max / 50 + DRIFT_TOLERANCE_STEPS; }
     bool Open();
     bool Close();
     bool MoveTo();
     void ConcludeCommand();
-    [[nodiscard]] uint8_t BeltPosition() const { return static_cast<uint8_t>(m_belt_position * 100 / m_belt_max); }
+    void JournalStep();
+    [[nodiscard]] uint8_t BeltPosition() const { return static_cast<uint8_t>(std::clamp(m_belt_position * 100 / m_belt_max, 0, 100)); }
     void PermitAutomaticControl();
 
+    /// How far the uncalibrated motor may go looking for a limit switch
     static constexpr int OUT_OF_BOUNDS_CLOSE = 30'000;
-    static constexpr int OUT_OF_BOUNDS_OPEN = -10'000;
     static constexpr TickType_t DIRECTION_CHANGE_DELAY_TICKS = pdMS_TO_TICKS(10);
-
-    uint m_pin_step;
-    uint m_pin_direction;
-    uint m_pin_limit_cw;
-    uint m_pin_limit_ccw;
+    /// Allowed error when finding a limit switch with a calibration, on top of 2 % of the belt
+    static constexpr int DRIFT_TOLERANCE_STEPS = 100;
+    /// Enough to clear the switch after running into it at full speed; homing backs off further while it stays closed
+    static constexpr int HOMING_BACKOFF_STEPS = 100;
+    static constexpr TickType_t POSITION_PUBLISH_INTERVAL = pdMS_TO_TICKS(250);
+    /// Edges closer than this to the previous one on the same switch are contact bounce
+    static constexpr uint32_t LIMIT_DEBOUNCE_US = 5'000;
+    static_assert(MOTOR_CHANNELS >= 1 && MOTOR_CHANNELS <= Flash::MAX_MOTOR_CHANNELS, "settings hold up to MAX_MOTOR_CHANNELS");
+    static_assert(TaskNotificationIndex::MOTOR + MOTOR_CHANNELS <= configTASK_NOTIFICATION_ARRAY_ENTRIES, "every channel needs its notification index");
+    static_assert(OUT_OF_BOUNDS_CLOSE < INT16_MAX, "position snapshot holds 16 bit positions");
+
+    const uint8_t m_channel;
+    MotorIO* m_io;
+
+    /// Set from the interrupt; a trip disarms the switch, so the next one needs ArmLimitSwitch() first
+    std::atomic<MotorIO::Limit> m_armed_limit = MotorIO::Limit::NONE;
+    std::atomic<bool> m_limit_tripped = false;
+    std::array<uint32_t, 2> m_limit_edge_us = {};
 
     bool m_previous_direction;
-    TickType_t m_step_finished = 0;
+    MotionPlanner m_planner;
+    MotionPlanner::Profile m_move_profile;
+    MotionPlanner::Profile m_calibration_profile;
 
     TaskHandle_t m_handle = nullptr;
 
-    RTOS::Variable<Command>* m_v_command;
     RTOS::Semaphore* m_s_control_auto;
     RTOS::Variable<uint8_t>* m_v_belt_position;
-    RTOS::Semaphore* m_s_notify;
-
-    Command m_command = CALIBRATE;
+    Notifier* m_notifier;
+
+    /// Post() and CurrentCommand() access these inside critical sections
+    Mail m_mailbox = {};
+    std::atomic<bool> m_mail_pending = false;
+    Sequence m_next_sequence = 1;
+
+    /// Written inside critical sections, as CurrentCommand() reads it from other tasks
+    Command m_command = STOP;
+    Sequence m_sequence = 0;
+    TaskHandle_t m_issuer = nullptr;
+    /// m_command resolved to steps once, when it was taken
+    int m_target_steps = 0;
     int m_belt_position = 0;
     int m_belt_max = 0;
+    /// Set at boot if Settings hold a calibration worth verifying instead of redoing
+    bool m_restore_calibration = false;
+    /// How far off the restored m_belt_position may be
+    int m_position_uncertainty = 0;
+    bool m_moving = false;
+    /// Position in the low and maximum in the high half word, so readers never see a torn pair
+    std::atomic<uint32_t> m_position_snapshot = 0;
+    /// Written inside critical sections, as GetDriftStatistics() reads it from other tasks
+    DriftStatistics m_drift = {};
+    uint8_t m_published_percent = UINT8_MAX;
+    TickType_t m_published_at = 0;
     Storage* m_storage;
+    PositionJournal* m_journal;
     Indicator* m_red;
 };
 
-/// TODO: Remove
-struct test_params {
-    RTOS::Variable<Motor::Command>* cmd;
-    RTOS::Semaphore* control_auto;
-    RTOS::Variable<float>* target;
-};
-
-void test_motor_commands(const test_params& params);
+/// Motor of every channel, indexed by channel
+using MotorChannels = std::array<Motor*, MOTOR_CHANNELS>;
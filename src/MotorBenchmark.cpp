@@ -0,0 +1,105 @@
+#include "MotorBenchmark.hpp"
+
+#include <array>
+#include <cstdlib>
+
+#include "Logger.hpp"
+#include "config.h"
+
+MotorBenchmark::MotorBenchmark(const Parameters& parameters)
+    : m_params(parameters)
+{
+    if (xTaskCreate(
+            TASK_KONDOM(MotorBenchmark, Task),
+            parameters.task_name,
+            TaskStackSize::BENCHMARK,
+            this,
+            TaskPriority::BENCHMARK,
+            &m_handle)
+        == pdTRUE) {
+        Logger::Log("Created task [{}]", parameters.task_name);
+    } else {
+        Logger::Log("Error: Failed to create task [{}]", parameters.task_name);
+    }
+}
+
+void MotorBenchmark::Task()
+{
+    Logger::Log("Initiated");
+    const TickType_t boot = xTaskGetTickCount();
+    // the motor calibrates by itself at boot; that command has no issuer to tell, so poll for its end
+    while (m_params.motor->CurrentCommand() != Motor::STOP) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    m_params.s_control_auto->Take(0);
+    const Motor::Position position = m_params.motor->GetPosition();
+    Logger::Log("{:<16} {:>7} ms  motor {:>6} / {:>6}  error {:>5}  lost {:>5}", "boot", (xTaskGetTickCount() - boot) * portTICK_PERIOD_MS,
+        position.steps, position.max, PositionError(), m_params.belt->LostSteps());
+
+    static const std::array script = {
+        Step { Motor::CALIBRATE, 0, 0 },
+        Step { Motor::Command { 50 }, 0, 0 },
+        Step { Motor::CLOSE_COMPLETELY, 0, 0 },
+        Step { Motor::Command { 75 }, 0, 0 },
+        Step { Motor::Permille(333), 0, 0 },
+        Step { Motor::Steps(1234), 0, 0 },
+        Step { Motor::OPEN_COMPLETELY, 0, 0 },
+        Step { Motor::Command { 80 }, pdMS_TO_TICKS(1500), 0 },
+        Step { Motor::Command { 20 }, 0, 0 },
+        Step { Motor::CLOSE, pdMS_TO_TICKS(500), 0 },
+        Step { Motor::STOP, 0, 0 },
+        // slipping belt: the position drifts until the next limit switch corrects it ...
+        Step { Motor::Command { 60 }, 0, 200 },
+        Step { Motor::Command { 10 }, 0, 200 },
+        Step { Motor::Command { 90 }, 0, 200 },
+        Step { Motor::OPEN_COMPLETELY, 0, 0 },
+        Step { Motor::Command { 50 }, 0, 0 },
+        // ... unless it drifted too far, which has the motor recalibrate
+        Step { Motor::Command { 90 }, 0, 10 },
+        Step { Motor::OPEN_COMPLETELY, 0, 0 },
+        Step { Motor::Command { 50 }, 0, 0 },
+        Step { Motor::CALIBRATE, 0, 0 },
+    };
+    for (const Step& step : script) {
+        Run(step);
+    }
+    const Motor::DriftStatistics drift = m_params.motor->GetDriftStatistics();
+    Logger::Log("Done. Worst position error {} steps, {} steps lost", m_worst_error, m_params.belt->LostSteps());
+    Logger::Log("Limit switch contacts: {}, corrected {}, recalibrations {}, worst drift {} steps",
+        drift.contacts, drift.corrected, drift.recalibrations, drift.worst_error);
+    vTaskDelete(nullptr);
+}
+
+void MotorBenchmark::Run(const Step& step)
+{
+    m_params.belt->SetMissedStepInterval(step.missed_step_interval);
+    const TickType_t start = xTaskGetTickCount();
+    const Motor::Sequence sequence = m_params.motor->Post(step.command, m_handle);
+    if (step.preempt_after != 0) {
+        vTaskDelay(step.preempt_after);
+    } else {
+        m_params.motor->WaitForCompletion(sequence, portMAX_DELAY);
+    }
+    const bool recalibrated = m_params.motor->CurrentCommand() == Motor::CALIBRATE;
+    while (m_params.motor->CurrentCommand() == Motor::CALIBRATE) {
+        // started by the motor itself, so nobody is told when it ends
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    if (step.command == Motor::CALIBRATE || recalibrated) {
+        // a finished calibration hands the motor back to the automatic control
+        m_params.s_control_auto->Take(0);
+    }
+    const Motor::Position position = m_params.motor->GetPosition();
+    const int error = PositionError();
+    if (step.preempt_after == 0 && std::abs(error) > std::abs(m_worst_error)) {
+        m_worst_error = error;
+    }
+    Logger::Log("{:<16} {:>7} ms  motor {:>6} / {:>6}  error {:>5}  lost {:>5}{}", Motor::CommandString(step.command),
+        (xTaskGetTickCount() - start) * portTICK_PERIOD_MS, position.steps, position.max, error, m_params.belt->LostSteps(),
+        step.preempt_after != 0 ? "  (preempted)" : recalibrated ? "  (recalibrated)" : "");
+}
+
+int MotorBenchmark::PositionError() const
+{
+    return m_params.motor->GetPosition().steps - (m_params.belt->Carriage() - m_params.belt->GetParameters().limit_cw);
+}
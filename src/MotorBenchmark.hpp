@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "Motor.hpp"
+#include "Semaphore.hpp"
+#include "SimulatedBelt.hpp"
+
+/// Runs a Motor on a SimulatedBelt through a fixed sequence of commands and logs, for each of them,
+/// how long it took and how far the motor's position is off from where the carriage really is.
+/// Build with MOTOR_SIMULATION to run it instead of driving the real curtain, or run tools/motor_bench
+/// to have it on the host.
+class MotorBenchmark {
+public:
+    struct Parameters {
+        const char* task_name;
+
+        Motor* motor;
+        SimulatedBelt* belt;
+        /// Held while running, so the ambient light sensor stays away from the motor
+        RTOS::Semaphore* s_control_auto;
+    };
+
+    explicit MotorBenchmark(const Parameters& parameters);
+
+private:
+    struct Step {
+        Motor::Command command;
+        /// Posts the next step this long after this one instead of waiting for it to finish, 0 to wait
+        TickType_t preempt_after;
+        /// Every n-th step from here on is lost, see SimulatedBelt::Parameters
+        uint32_t missed_step_interval;
+    };
+
+    void Task();
+    void Run(const Step& step);
+    /// Motor position minus where the carriage is, both counted from the CW switch
+    [[nodiscard]] int PositionError() const;
+
+    TaskHandle_t m_handle = nullptr;
+
+    Parameters m_params;
+    /// Worst PositionError() after a command, in either direction
+    int m_worst_error = 0;
+};
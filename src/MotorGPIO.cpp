@@ -0,0 +1,87 @@
+#include "MotorGPIO.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include <hardware/gpio.h>
+#include <hardware/irq.h>
+
+#include "Logger.hpp"
+
+std::array<MotorGPIO*, MotorGPIO::MAX_INSTANCES> MotorGPIO::instances = {};
+
+MotorGPIO::MotorGPIO(const Parameters& parameters)
+    : m_stepper(static_cast<uint>(parameters.step))
+    , m_pin_direction(static_cast<uint>(parameters.direction))
+    , m_pin_limit_cw(static_cast<uint>(parameters.limit_cw))
+    , m_pin_limit_ccw(static_cast<uint>(parameters.limit_ccw))
+{
+    gpio_init(m_pin_direction);
+    gpio_set_dir(m_pin_direction, GPIO_OUT);
+
+    gpio_init(m_pin_limit_cw);
+    gpio_set_dir(m_pin_limit_cw, GPIO_IN);
+    gpio_pull_up(m_pin_limit_cw);
+
+    gpio_init(m_pin_limit_ccw);
+    gpio_set_dir(m_pin_limit_ccw, GPIO_IN);
+    gpio_pull_up(m_pin_limit_ccw);
+
+    static constexpr std::array<void (*)(), MAX_INSTANCES> limit_switch_irqs = {
+        IRQ_LimitSwitches<0>,
+        IRQ_LimitSwitches<1>,
+        IRQ_LimitSwitches<2>,
+    };
+    const auto slot = std::find(instances.begin(), instances.end(), nullptr);
+    if (slot != instances.end()) {
+        *slot = this;
+        // raw handlers keep these pins away from the callback other drivers set with gpio_set_irq_callback()
+        gpio_add_raw_irq_handler_masked((1u << m_pin_limit_cw) | (1u << m_pin_limit_ccw), limit_switch_irqs.at(slot - instances.begin()));
+        gpio_set_irq_enabled(m_pin_limit_cw, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true);
+        gpio_set_irq_enabled(m_pin_limit_ccw, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true);
+        irq_set_enabled(IO_IRQ_BANK0, true);
+    } else {
+        Logger::Log("Error: Too many motors, limit switches of [{}] are only polled", parameters.name);
+    }
+}
+
+void MotorGPIO::SetDirection(const bool direction)
+{
+    gpio_put(m_pin_direction, direction);
+}
+
+bool MotorGPIO::IsLimitPressed(const Limit limit) const
+{
+    // the switches pull the pin low when pressed
+    switch (limit) {
+    case Limit::CW:
+        return !gpio_get(m_pin_limit_cw);
+    case Limit::CCW:
+        return !gpio_get(m_pin_limit_ccw);
+    default:
+        return false;
+    }
+}
+
+void MotorGPIO::SetLimitHandler(const LimitHandler handler, void* context)
+{
+    // both are read in the interrupt, so swap them with it masked
+    irq_set_enabled(IO_IRQ_BANK0, false);
+    m_limit_handler = handler;
+    m_limit_context = context;
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+void MotorGPIO::LimitSwitchISR()
+{
+    BaseType_t woken = pdFALSE;
+    for (const auto& [pin, limit] : { std::pair { m_pin_limit_cw, Limit::CW }, std::pair { m_pin_limit_ccw, Limit::CCW } }) {
+        if (const uint32_t events = gpio_get_irq_event_mask(pin) & (GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE); events != 0) {
+            gpio_acknowledge_irq(pin, events);
+            if (m_limit_handler != nullptr) {
+                m_limit_handler(m_limit_context, limit, (events & GPIO_IRQ_EDGE_FALL) != 0, &woken);
+            }
+        }
+    }
+    portYIELD_FROM_ISR(woken);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "Flash.hpp"
+#include "MotorIO.hpp"
+#include "StepGenerator.hpp"
+
+// Assuming pinout
+//  1. Step
+//  2. Direction
+//  3. Limit switch CW
+//  4. Limit switch CCW
+//  5. NC
+//  6. NC
+//  7. GND
+//  8. 3V3
+//  9. NC
+// 10. NC
+
+/// Stepper driver and limit switches on GPIO, step pulses from a PIO state machine
+class MotorGPIO final : public MotorIO {
+public:
+    enum class PinStep : uint { };
+    enum class PinDirection : uint { };
+    enum class PinLimitCW : uint { };
+    enum class PinLimitCCW : uint { };
+
+    struct Parameters {
+        const char* name;
+
+        PinStep step;
+        PinDirection direction;
+        PinLimitCW limit_cw;
+        PinLimitCCW limit_ccw;
+    };
+
+    explicit MotorGPIO(const Parameters& parameters);
+
+    void SetDirection(bool direction) override;
+    [[nodiscard]] bool IsLimitPressed(Limit limit) const override;
+    void SetLimitHandler(LimitHandler handler, void* context) override;
+
+    bool Push(const StepGenerator::Segment& segment) override { return m_stepper.Push(segment); }
+    uint32_t Collect() override { return m_stepper.Collect(); }
+    uint32_t Abort() override { return m_stepper.Abort(); }
+    void Freeze() override { m_stepper.Freeze(); }
+    [[nodiscard]] bool Idle() const override { return m_stepper.Idle(); }
+    [[nodiscard]] bool Full() const override { return m_stepper.Full(); }
+    [[nodiscard]] uint32_t Pending() const override { return m_stepper.Pending(); }
+
+private:
+    /// Raw GPIO handler for the limit switches of instances[INDEX]
+    template <size_t INDEX>
+    static void IRQ_LimitSwitches() { instances.at(INDEX)->LimitSwitchISR(); }
+    void LimitSwitchISR();
+
+    static constexpr size_t MAX_INSTANCES = Flash::MAX_MOTOR_CHANNELS;
+    static std::array<MotorGPIO*, MAX_INSTANCES> instances;
+
+    StepGenerator m_stepper;
+    uint m_pin_direction;
+    uint m_pin_limit_cw;
+    uint m_pin_limit_ccw;
+
+    LimitHandler m_limit_handler = nullptr;
+    void* m_limit_context = nullptr;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+#include <FreeRTOS.h>
+
+#include "StepGenerator.hpp"
+
+/// What a Motor drives: a step pulse train, a direction output and the two limit switches.
+/// MotorGPIO is the real thing, SimulatedBelt a curtain to run the motor task against without one.
+/// The step side keeps the contract of StepGenerator.
+class MotorIO {
+public:
+    enum class Limit : int {
+        NONE = -1,
+        CW = 0,
+        CCW = 1,
+    };
+    /// Called in interrupt context on edges of a limit switch; 'pressed' if the edge closed it
+    using LimitHandler = void (*)(void* context, Limit limit, bool pressed, BaseType_t* woken);
+
+    virtual ~MotorIO() = default;
+
+    virtual void SetDirection(bool direction) = 0;
+    [[nodiscard]] virtual bool IsLimitPressed(Limit limit) const = 0;
+    /// Edges before this is called go unreported
+    virtual void SetLimitHandler(LimitHandler handler, void* context) = 0;
+
+    virtual bool Push(const StepGenerator::Segment& segment) = 0;
+    virtual uint32_t Collect() = 0;
+    virtual uint32_t Abort() = 0;
+    /// Safe to call from the limit handler
+    virtual void Freeze() = 0;
+    [[nodiscard]] virtual bool Idle() const = 0;
+    [[nodiscard]] virtual bool Full() const = 0;
+    [[nodiscard]] virtual uint32_t Pending() const = 0;
+};
@@ -0,0 +1,58 @@
+#include "Notifier.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "Logger.hpp"
+
+Notifier::Subscriber::Subscriber(const Parameters& parameters)
+    : m_events(parameters.name)
+    , m_topics(parameters.topics & ALL)
+    , m_min_interval(parameters.min_interval)
+    , m_max_latency(parameters.max_latency)
+{
+}
+
+void Notifier::Subscriber::Mark(const Topics topics)
+{
+    if (const Topics relevant = topics & m_topics; relevant != 0) {
+        m_events.Set(relevant);
+    }
+}
+
+Notifier::Topics Notifier::Subscriber::Wait(const TickType_t wait_time_ticks, Topics subset)
+{
+    subset &= m_topics;
+    assert(subset != 0);
+    Topics topics = m_events.TakeAny(subset, wait_time_ticks);
+    if (topics == 0) {
+        return 0;
+    }
+    const TickType_t since_last = xTaskGetTickCount() - m_last_delivery;
+    if (since_last < m_min_interval) {
+        // let further changes pile up instead of delivering each one separately
+        vTaskDelay(std::min(m_min_interval - since_last, m_max_latency));
+        topics |= m_events.Clear(subset) & subset;
+    }
+    m_last_delivery = xTaskGetTickCount();
+    return topics;
+}
+
+Notifier::Subscriber* Notifier::Subscribe(const Subscriber::Parameters& parameters)
+{
+    if (m_subscriber_count == m_subscribers.size()) {
+        Logger::Log("Error: Too many subscribers, cannot subscribe [{}]", parameters.name);
+        return nullptr;
+    }
+    auto* subscriber = new Subscriber(parameters);
+    m_subscribers.at(m_subscriber_count) = subscriber;
+    ++m_subscriber_count;
+    return subscriber;
+}
+
+void Notifier::Publish(const Topics topics)
+{
+    for (size_t index = 0; index < m_subscriber_count; ++index) {
+        m_subscribers.at(index)->Mark(topics);
+    }
+}
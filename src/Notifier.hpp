@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "EventGroup.hpp"
+
+/// Publishes which part of the system state changed to any number of subscribers.
+/// Every subscriber has its own dirty bits, so a slow consumer never hides
+/// a change from a fast one.
+class Notifier {
+public:
+    using Topics = RTOS::EventGroup::Bits;
+
+    enum Topic : Topics {
+        bMOTOR = 0b0001, /// belt position, motor command
+        bLUX = 0b0010, /// lux measurements, lux target
+        bSETTINGS = 0b0100, /// anything in Flash::Settings
+        bMODE = 0b1000, /// manual / auto / calibrating
+        ALL = bMOTOR | bLUX | bSETTINGS | bMODE,
+    };
+
+    class Subscriber {
+    public:
+        struct Parameters {
+            const char* name;
+            Topics topics;
+            /// Deliveries closer together than this are coalesced into one
+            TickType_t min_interval;
+            /// A pending change is never held back for longer than this by coalescing
+            TickType_t max_latency;
+        };
+
+        explicit Subscriber(const Parameters& parameters);
+
+        /// Blocks until any subscribed topic out of 'subset' is dirty, then returns and clears those dirty topics.
+        /// Dirty topics outside 'subset' are kept for a later Wait().
+        /// Returns 0 if nothing changed within 'wait_time_ticks'.
+        Topics Wait(TickType_t wait_time_ticks, Topics subset = ALL);
+
+        [[nodiscard]] Topics Subscribed() const { return m_topics; }
+        [[nodiscard]] const char* Name() const { return m_events.Name(); }
+
+    private:
+        void Mark(Topics topics);
+
+        RTOS::EventGroup m_events;
+        const Topics m_topics;
+        const TickType_t m_min_interval;
+        const TickType_t m_max_latency;
+        TickType_t m_last_delivery = 0;
+
+        friend Notifier;
+    };
+
+    explicit Notifier() = default;
+
+    /// Subscribers are expected to be created before the scheduler starts
+    Subscriber* Subscribe(const Subscriber::Parameters& parameters);
+    void Publish(Topics topics);
+
+private:
+    static constexpr size_t MAX_SUBSCRIBERS = 4;
+
+    std::array<Subscriber*, MAX_SUBSCRIBERS> m_subscribers = {};
+    size_t m_subscriber_count = 0;
+};
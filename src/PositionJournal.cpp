@@ -0,0 +1,295 @@
+#include "PositionJournal.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <hardware/flash.h>
+#include <hardware/regs/addressmap.h>
+#include <pico/flash.h>
+
+#include "CRC.hpp"
+#include "Logger.hpp"
+#include "config.h"
+
+PositionJournal::PositionJournal(const Parameters& parameters)
+    : m_checkpoint_steps(parameters.checkpoint_steps)
+    , m_checkpoint_interval(parameters.checkpoint_interval)
+    , m_max_checkpoints(parameters.max_checkpoints_per_motion)
+    , m_queue(QUEUE_LENGTH, "PositionJournal")
+{
+    Recover();
+    if (xTaskCreate(
+            TASK_KONDOM(PositionJournal, Task),
+            parameters.task_name,
+            TaskStackSize::JOURNAL,
+            this,
+            TaskPriority::JOURNAL,
+            &m_handle)
+        == pdPASS) {
+        Logger::Log("Created task [{}]", parameters.task_name);
+    } else {
+        Logger::Log("Error: Failed to create task [{}]", parameters.task_name);
+    }
+}
+
+void PositionJournal::Recover()
+{
+    ptrdiff_t newest_address = -1;
+    std::array<ptrdiff_t, Flash::MAX_MOTOR_CHANNELS> channel_addresses;
+    channel_addresses.fill(-1);
+    std::array<Entry, Flash::MAX_MOTOR_CHANNELS> channel_newest = {};
+    for (ptrdiff_t address = Flash::JOURNAL_BOTTOM; address < Flash::JOURNAL_TOP; address += ENTRY_SIZE) {
+        const Entry entry = Read(address);
+        if (!IsValid(entry) || entry.channel >= Flash::MAX_MOTOR_CHANNELS) {
+            continue;
+        }
+        if (newest_address < 0 || entry.sequence > m_sequence) {
+            newest_address = address;
+            m_sequence = entry.sequence;
+        }
+        if (channel_addresses.at(entry.channel) < 0 || entry.sequence > channel_newest.at(entry.channel).sequence) {
+            channel_addresses.at(entry.channel) = address;
+            channel_newest.at(entry.channel) = entry;
+        }
+    }
+    if (newest_address < 0) {
+        Logger::Log("[Journal] Empty");
+        return;
+    }
+    m_next = NextSlot(newest_address);
+
+    for (size_t channel = 0; channel < Flash::MAX_MOTOR_CHANNELS; ++channel) {
+        if (channel_addresses.at(channel) < 0) {
+            continue;
+        }
+        const Entry& newest = channel_newest.at(channel);
+        Estimate& restored = m_restored.at(channel);
+        switch (newest.type) {
+        case STOPPED:
+            restored = { State::STOPPED, newest.position, 0 };
+            break;
+        case MOTION:
+        case CHECKPOINT:
+            // motion is monotonic, so the belt stopped somewhere between here and the target
+            restored = {
+                State::MOVING,
+                (newest.position + newest.target) / 2,
+                std::abs(newest.target - newest.position) / 2 + 1,
+            };
+            break;
+        default:
+            restored = { State::LOST, 0, 0 };
+            break;
+        }
+        Logger::Log("[Journal] Channel {} entry #{} at [0x{:X}]: type {}, position {}, target {}",
+            channel, newest.sequence, channel_addresses.at(channel), +newest.type, newest.position, newest.target);
+    }
+}
+
+void PositionJournal::BeginMotion(const uint8_t channel, const int position, const int target)
+{
+    m_motions.at(channel) = {
+        .target = target,
+        .checkpoint_position = position,
+        .checkpoint_tick = xTaskGetTickCount(),
+        .checkpoints = 0,
+    };
+    Post(MOTION, channel, position, target, POST_WAIT);
+}
+
+void PositionJournal::Retarget(const uint8_t channel, const int position, const int target)
+{
+    Motion& motion = m_motions.at(channel);
+    motion.target = target;
+    if (motion.checkpoints + 1 < m_max_checkpoints) {
+        motion.checkpoint_position = position;
+        motion.checkpoint_tick = xTaskGetTickCount();
+        ++motion.checkpoints;
+        Post(CHECKPOINT, channel, position, target, POST_WAIT);
+    } else if (motion.checkpoints < m_max_checkpoints) {
+        // a restore would head for a target the motor no longer does
+        motion.checkpoints = m_max_checkpoints;
+        Post(ADRIFT, channel, position, target, POST_WAIT);
+    }
+}
+
+void PositionJournal::Step(const uint8_t channel, const int position)
+{
+    Motion& motion = m_motions.at(channel);
+    // the last checkpoint is kept for Retarget()
+    if (std::abs(position - motion.checkpoint_position) < m_checkpoint_steps || motion.checkpoints + 1 >= m_max_checkpoints) {
+        return;
+    }
+    const TickType_t now = xTaskGetTickCount();
+    if (now - motion.checkpoint_tick < m_checkpoint_interval) {
+        return;
+    }
+    motion.checkpoint_position = position;
+    motion.checkpoint_tick = now;
+    ++motion.checkpoints;
+    // never make the motor wait; a dropped checkpoint only widens the bound
+    Post(CHECKPOINT, channel, position, motion.target, 0);
+}
+
+void PositionJournal::EndMotion(const uint8_t channel, const int position)
+{
+    Post(STOPPED, channel, position, position, POST_WAIT);
+}
+
+void PositionJournal::Invalidate(const uint8_t channel)
+{
+    Post(LOST, channel, 0, 0, POST_WAIT);
+}
+
+void PositionJournal::Post(const Type type, const uint8_t channel, const int position, const int target, const TickType_t wait)
+{
+    const Entry entry = {
+        .sequence = 0,
+        .type = type,
+        .channel = channel,
+        .crc = 0,
+        .position = position,
+        .target = target,
+    };
+    if (!m_queue.Append(entry, wait)) {
+        Logger::Log("[Journal] Warning: Queue full, dropped entry of type {} for channel {}", +type, channel);
+    }
+}
+
+void PositionJournal::Task()
+{
+    Logger::Log("Initiated");
+    Entry entry;
+    while (true) {
+        m_queue.Receive(&entry, portMAX_DELAY);
+        m_moving.at(entry.channel) = entry.type == MOTION || entry.type == CHECKPOINT || entry.type == ADRIFT;
+        if (Write(entry)) {
+            m_dropped.at(entry.channel).type = NONE;
+            WriteDropped();
+        } else {
+            // the channel restores from its last entry written, which bounds the belt less tightly or not at all
+            Logger::Log("[Journal] Warning: Dropped entry of type {} for channel {} rather than erase mid-motion", +entry.type, entry.channel);
+            m_dropped.at(entry.channel) = entry;
+        }
+        if (entry.type == STOPPED || entry.type == LOST) {
+            EraseNextSectorIfLow();
+        }
+    }
+}
+
+bool PositionJournal::Write(Entry entry)
+{
+    // skip slots left dirty by an interrupted write; a new sector always starts clean
+    while (m_next % FLASH_SECTOR_SIZE != 0 && !IsErased(m_next, ENTRY_SIZE)) {
+        m_next = NextSlot(m_next);
+    }
+    if (m_next % FLASH_SECTOR_SIZE == 0 && !IsErased(m_next, FLASH_SECTOR_SIZE)) {
+        // should have been erased while idle; a moving motor would stall for it
+        if (AnyMoving()) {
+            return false;
+        }
+        ptrdiff_t sector = m_next;
+        flash_safe_execute(Erase, &sector, UINT32_MAX);
+        ++m_erases;
+    }
+
+    entry.sequence = ++m_sequence;
+    entry.crc = Checksum(entry);
+
+    // programming 0xFF leaves the other entries in the page untouched
+    m_page.fill(0xFF);
+    std::memcpy(m_page.data() + m_next % FLASH_PAGE_SIZE, &entry, ENTRY_SIZE);
+    ProgramParameters params = {
+        .address = m_next - m_next % FLASH_PAGE_SIZE,
+        .data = m_page.data(),
+    };
+    flash_safe_execute(Program, &params, UINT32_MAX);
+    if (!IsValid(Read(m_next))) {
+        Logger::Log("[Journal] Error: Entry #{} at [0x{:X}] failed verification", entry.sequence, m_next);
+    }
+    m_next = NextSlot(m_next);
+    return true;
+}
+
+void PositionJournal::WriteDropped()
+{
+    for (Entry& dropped : m_dropped) {
+        if (dropped.type != NONE && Write(dropped)) {
+            dropped.type = NONE;
+        }
+    }
+}
+
+void PositionJournal::EraseNextSectorIfLow()
+{
+    if (AnyMoving()) {
+        // left to the end of the last motion
+        return;
+    }
+    const ptrdiff_t offset = m_next % FLASH_SECTOR_SIZE;
+    ptrdiff_t sector = m_next;
+    if (offset != 0) {
+        // a whole motion of every channel worth of entries has to fit without erasing mid-motion
+        const size_t free_slots = (FLASH_SECTOR_SIZE - offset) / ENTRY_SIZE;
+        if (free_slots >= MOTOR_CHANNELS * (m_max_checkpoints + 2u)) {
+            return;
+        }
+        sector = m_next - offset + FLASH_SECTOR_SIZE;
+        if (sector >= Flash::JOURNAL_TOP) {
+            sector = Flash::JOURNAL_BOTTOM;
+        }
+    }
+    if (IsErased(sector, FLASH_SECTOR_SIZE)) {
+        return;
+    }
+    flash_safe_execute(Erase, &sector, UINT32_MAX);
+    ++m_erases;
+    Logger::Log("[Journal] Erased sector [0x{:X}] ahead of use; {} erases since boot", sector, m_erases);
+}
+
+bool PositionJournal::AnyMoving() const
+{
+    return std::any_of(m_moving.begin(), m_moving.end(), [](const bool moving) { return moving; });
+}
+
+void PositionJournal::Program(void* program_parameters)
+{
+    const auto* params = static_cast<ProgramParameters*>(program_parameters);
+    flash_range_program(params->address, params->data, FLASH_PAGE_SIZE);
+}
+
+void PositionJournal::Erase(void* sector_address)
+{
+    flash_range_erase(*static_cast<ptrdiff_t*>(sector_address), FLASH_SECTOR_SIZE);
+}
+
+PositionJournal::Entry PositionJournal::Read(const ptrdiff_t address)
+{
+    Entry entry;
+    std::memcpy(&entry, reinterpret_cast<const void*>(XIP_BASE + address), ENTRY_SIZE);
+    return entry;
+}
+
+bool PositionJournal::IsValid(const Entry& entry)
+{
+    return entry.sequence != UINT32_MAX && entry.crc == Checksum(entry);
+}
+
+uint16_t PositionJournal::Checksum(Entry entry)
+{
+    entry.crc = 0;
+    return CRC16::CCITT(reinterpret_cast<const uint8_t*>(&entry), ENTRY_SIZE);
+}
+
+bool PositionJournal::IsErased(const ptrdiff_t address, const size_t length)
+{
+    const auto* pointer = reinterpret_cast<const uint8_t*>(XIP_BASE + address);
+    return std::all_of(pointer, pointer + length, [](const uint8_t byte) { return byte == 0xFF; });
+}
+
+ptrdiff_t PositionJournal::NextSlot(const ptrdiff_t address)
+{
+    const ptrdiff_t next = address + ENTRY_SIZE;
+    return next < Flash::JOURNAL_TOP ? next : Flash::JOURNAL_BOTTOM;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "Flash.hpp"
+#include "Queue.hpp"
+
+/// Remembers where the belt is across resets. Motion start, checkpoints and motion end are
+/// appended as 16 byte entries to a ring of sectors at the top of the settings region.
+/// A separate task programs them, so the motor only ever posts to a queue, and sectors are
+/// erased ahead of time while the motors are idle, never while one moves. Every motor channel
+/// has its own track of entries.
+class PositionJournal {
+public:
+    struct Parameters {
+        const char* task_name;
+
+        /// A checkpoint is written once the belt has moved this many steps since the last one ...
+        int checkpoint_steps;
+        /// ... but not more often than this ...
+        TickType_t checkpoint_interval;
+        /// ... and not more than this many times per motion, new targets included, which bounds
+        /// flash wear per move
+        uint16_t max_checkpoints_per_motion;
+    };
+
+    enum class State : uint8_t {
+        EMPTY, /// nothing journaled yet
+        LOST, /// the position was unknown when the journal was last written
+        STOPPED, /// exact position
+        MOVING, /// interrupted mid-motion; somewhere between the last checkpoint and the target
+    };
+
+    struct Estimate {
+        State state;
+        int position;
+        /// The belt is within position +- uncertainty steps
+        int uncertainty;
+    };
+
+    explicit PositionJournal(const Parameters& parameters);
+
+    /// State of 'channel' found in flash at construction. A channel idle for long enough to have
+    /// its entries overwritten comes back EMPTY; it stopped cleanly, so the settings know where it is.
+    [[nodiscard]] Estimate Restore(uint8_t channel) const { return m_restored.at(channel); }
+
+    /// Called from the motor task of 'channel' only
+    void BeginMotion(uint8_t channel, int position, int target);
+    /// The motion goes on towards another 'target', journaled as a checkpoint. The last checkpoint of
+    /// a motion is kept for this; once it is spent, the channel is journaled ADRIFT until the motion ends.
+    void Retarget(uint8_t channel, int position, int target);
+    void Step(uint8_t channel, int position);
+    void EndMotion(uint8_t channel, int position);
+    void Invalidate(uint8_t channel);
+
+private:
+    enum Type : uint8_t {
+        NONE = 0, /// never written
+        MOTION = 1,
+        CHECKPOINT = 2,
+        STOPPED = 3,
+        LOST = 4,
+        /// mid-motion towards a target not journaled; restores as LOST
+        ADRIFT = 5,
+    };
+
+    struct Entry {
+        uint32_t sequence;
+        Type type;
+        /// Entries from before there were channels have 0 here
+        uint8_t channel;
+        uint16_t crc; /// CRC16::CCITT over the entry with this field 0
+        int32_t position;
+        int32_t target;
+    };
+
+    /// Checkpoint state of the motion a channel is in
+    struct Motion {
+        int32_t target;
+        int checkpoint_position;
+        TickType_t checkpoint_tick;
+        uint16_t checkpoints;
+    };
+
+    struct ProgramParameters {
+        ptrdiff_t address;
+        const uint8_t* data;
+    };
+
+    static constexpr size_t ENTRY_SIZE = sizeof(Entry);
+    static constexpr UBaseType_t QUEUE_LENGTH = 8;
+    static constexpr TickType_t POST_WAIT = pdMS_TO_TICKS(10);
+
+    static_assert(ENTRY_SIZE == 16 && FLASH_PAGE_SIZE % ENTRY_SIZE == 0);
+    static_assert((Flash::JOURNAL_TOP - Flash::JOURNAL_BOTTOM) / FLASH_SECTOR_SIZE >= 2);
+
+    void Task();
+    void Post(Type type, uint8_t channel, int position, int target, TickType_t wait);
+    /// False if the entry would need a sector erased while a channel is mid-motion
+    bool Write(Entry entry);
+    /// Writes the newest entry dropped of each channel, where there is room now
+    void WriteDropped();
+    void EraseNextSectorIfLow();
+    [[nodiscard]] bool AnyMoving() const;
+    void Recover();
+
+    static void Program(void* program_parameters);
+    static void Erase(void* sector_address);
+    [[nodiscard]] static Entry Read(ptrdiff_t address);
+    [[nodiscard]] static bool IsValid(const Entry& entry);
+    [[nodiscard]] static uint16_t Checksum(Entry entry);
+    [[nodiscard]] static bool IsErased(ptrdiff_t address, size_t length);
+    [[nodiscard]] static ptrdiff_t NextSlot(ptrdiff_t address);
+
+    const int m_checkpoint_steps;
+    const TickType_t m_checkpoint_interval;
+    const uint16_t m_max_checkpoints;
+
+    RTOS::Queue<Entry> m_queue;
+    std::array<Estimate, Flash::MAX_MOTOR_CHANNELS> m_restored = {};
+
+    /// Motor task side
+    std::array<Motion, Flash::MAX_MOTOR_CHANNELS> m_motions = {};
+
+    /// Journal task side
+    ptrdiff_t m_next = Flash::JOURNAL_BOTTOM;
+    uint32_t m_sequence = 0;
+    uint32_t m_erases = 0;
+    /// Channels whose newest entry was MOTION, CHECKPOINT or ADRIFT
+    std::array<bool, Flash::MAX_MOTOR_CHANNELS> m_moving = {};
+    /// Newest entry of each channel that could not be written, NONE if there is none
+    std::array<Entry, Flash::MAX_MOTOR_CHANNELS> m_dropped = {};
+    std::array<uint8_t, FLASH_PAGE_SIZE> m_page;
+
+    TaskHandle_t m_handle = nullptr;
+};
@@ -72,6 +72,18 @@ const char* RTC::DayOfWeekString(const datetime_t& time)
     }
 }
 
+uint32_t RTC::ToEpoch(const datetime_t& time)
+{
+    // days from civil date, with March as the first month so leap days fall at the end of the year
+    const int year = time.year - (time.month <= 2 ? 1 : 0);
+    const int era = year / 400;
+    const int year_of_era = year - era * 400;
+    const int day_of_year = (153 * (time.month + (time.month > 2 ? -3 : 9)) + 2) / 5 + time.day - 1;
+    const int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    const int64_t days = static_cast<int64_t>(era) * 146097 + day_of_era - 719468;
+    return static_cast<uint32_t>(((days * 24 + time.hour) * 60 + time.min) * 60 + time.sec);
+}
+
 datetime_t RTC::Default()
 {
     enum : uint64_t {
@@ -14,6 +14,8 @@ public:
     [[nodiscard]] datetime_t GetDatetime();
     [[nodiscard]] static const char* DayOfWeekString(const datetime_t& time);
     [[nodiscard]] static const char* MonthString(const datetime_t& time);
+    /// Seconds since 1970-01-01 00:00:00, treating the RTC as UTC
+    [[nodiscard]] static uint32_t ToEpoch(const datetime_t& time);
     [[nodiscard]] bool IsSet() const { return m_is_set; }
 
 private:
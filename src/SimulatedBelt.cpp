@@ -0,0 +1,209 @@
+#include "SimulatedBelt.hpp"
+
+#include <algorithm>
+
+#include <hardware/timer.h>
+#include <task.h>
+
+#include "Logger.hpp"
+
+SimulatedBelt::SimulatedBelt(const Parameters& parameters)
+    : m_params(parameters)
+    , m_carriage(std::clamp(parameters.start, 0, parameters.length))
+{
+    m_contacts.at(0).closed = m_contacts.at(0).level = m_carriage <= m_params.limit_cw;
+    m_contacts.at(1).closed = m_contacts.at(1).level = m_carriage >= m_params.limit_ccw;
+    // negative: the period runs from the start of one callback to the next
+    if (add_repeating_timer_us(-TIMER_PERIOD_US, OnTimer, this, &m_timer)) {
+        Logger::Log("Simulating belt [{}]: {} steps, switches at {} and {}, carriage at {}",
+            m_params.name, m_params.length, m_params.limit_cw, m_params.limit_ccw, m_carriage);
+    } else {
+        Logger::Log("Error: No timer left to simulate belt [{}]", m_params.name);
+    }
+}
+
+void SimulatedBelt::SetDirection(const bool direction)
+{
+    taskENTER_CRITICAL();
+    m_direction = direction;
+    taskEXIT_CRITICAL();
+}
+
+bool SimulatedBelt::IsLimitPressed(const Limit limit) const
+{
+    return limit != Limit::NONE && ContactOf(limit).level;
+}
+
+void SimulatedBelt::SetLimitHandler(const LimitHandler handler, void* context)
+{
+    taskENTER_CRITICAL();
+    m_limit_handler = handler;
+    m_limit_context = context;
+    taskEXIT_CRITICAL();
+}
+
+bool SimulatedBelt::Push(const StepGenerator::Segment& segment)
+{
+    if (Full()) {
+        return false;
+    }
+    if (segment.steps == 0) {
+        return true;
+    }
+    taskENTER_CRITICAL();
+    Queued& queued = m_queued.at((m_queued_head + m_queued_count) % m_queued.size());
+    // a segment that does not start where the previous one ended found the generator starved
+    queued = { .segment = segment, .start_us = time_us_32() };
+    ++m_queued_count;
+    m_pending_steps += segment.steps;
+    taskEXIT_CRITICAL();
+    return true;
+}
+
+uint32_t SimulatedBelt::Collect()
+{
+    uint32_t steps = 0;
+    taskENTER_CRITICAL();
+    for (; m_finished != 0; --m_finished) {
+        steps += m_queued.at(m_queued_head).segment.steps;
+        m_queued_head = (m_queued_head + 1) % m_queued.size();
+        --m_queued_count;
+    }
+    m_pending_steps -= steps;
+    taskEXIT_CRITICAL();
+    return steps;
+}
+
+uint32_t SimulatedBelt::Abort()
+{
+    taskENTER_CRITICAL();
+    uint32_t steps = m_running_steps;
+    for (size_t i = 0; i < m_finished; ++i) {
+        steps += m_queued.at((m_queued_head + i) % m_queued.size()).segment.steps;
+    }
+    m_queued_head = 0;
+    m_queued_count = 0;
+    m_finished = 0;
+    m_pending_steps = 0;
+    m_running_steps = 0;
+    m_frozen = false;
+    taskEXIT_CRITICAL();
+    return steps;
+}
+
+int SimulatedBelt::Carriage() const
+{
+    taskENTER_CRITICAL();
+    const int carriage = m_carriage;
+    taskEXIT_CRITICAL();
+    return carriage;
+}
+
+uint32_t SimulatedBelt::LostSteps() const
+{
+    taskENTER_CRITICAL();
+    const uint32_t lost = m_lost_steps;
+    taskEXIT_CRITICAL();
+    return lost;
+}
+
+void SimulatedBelt::SetMissedStepInterval(const uint32_t interval)
+{
+    taskENTER_CRITICAL();
+    m_params.missed_step_interval = interval;
+    taskEXIT_CRITICAL();
+}
+
+bool SimulatedBelt::OnTimer(repeating_timer_t* timer)
+{
+    auto* belt = static_cast<SimulatedBelt*>(timer->user_data);
+    BaseType_t woken = pdFALSE;
+    // the motor task pushes, collects and aborts under the same lock
+    const UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    belt->Advance(time_us_32(), &woken);
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+    portYIELD_FROM_ISR(woken);
+    return true;
+}
+
+SimulatedBelt::Queued* SimulatedBelt::Running()
+{
+    return m_finished < m_queued_count ? &m_queued.at((m_queued_head + m_finished) % m_queued.size()) : nullptr;
+}
+
+void SimulatedBelt::Advance(const uint32_t now, BaseType_t* woken)
+{
+    while (true) {
+        // the earliest of the next step and the next contact bounce goes first
+        bool found = false;
+        uint32_t at = 0;
+        Limit bounce = Limit::NONE;
+        if (const Queued* running = Running(); running != nullptr && !m_frozen) {
+            at = running->start_us + m_running_steps * std::max(running->segment.period_us, StepGenerator::MIN_PERIOD_US);
+            found = true;
+        }
+        for (const Limit limit : { Limit::CW, Limit::CCW }) {
+            const Contact& contact = ContactOf(limit);
+            if (contact.chatter != 0 && (!found || static_cast<int32_t>(contact.next_toggle_us - at) < 0)) {
+                at = contact.next_toggle_us;
+                bounce = limit;
+                found = true;
+            }
+        }
+        if (!found || static_cast<int32_t>(now - at) < 0) {
+            return;
+        }
+        if (bounce == Limit::NONE) {
+            Step(at, woken);
+        } else {
+            Contact& contact = ContactOf(bounce);
+            --contact.chatter;
+            contact.next_toggle_us += m_params.bounce_us / (2 * m_params.bounce_edges + 1);
+            Toggle(bounce, !contact.level, woken);
+        }
+    }
+}
+
+void SimulatedBelt::Step(const uint32_t at, BaseType_t* woken)
+{
+    Queued& running = *Running();
+    const int target = m_carriage + (m_direction ? -1 : 1);
+    const bool missed = m_params.missed_step_interval != 0 && ++m_step_count % m_params.missed_step_interval == 0;
+    if (missed || target < 0 || target > m_params.length) {
+        ++m_lost_steps;
+    } else {
+        m_carriage = target;
+    }
+    if (++m_running_steps == running.segment.steps) {
+        const uint32_t period = std::max(running.segment.period_us, StepGenerator::MIN_PERIOD_US);
+        const uint32_t end = running.start_us + running.segment.steps * period;
+        m_running_steps = 0;
+        ++m_finished;
+        if (Queued* following = Running(); following != nullptr && static_cast<int32_t>(following->start_us - end) < 0) {
+            // queued in time, so it carries on without a gap
+            following->start_us = end;
+        }
+    }
+    for (const Limit limit : { Limit::CW, Limit::CCW }) {
+        Contact& contact = ContactOf(limit);
+        const bool closed = limit == Limit::CW ? m_carriage <= m_params.limit_cw : m_carriage >= m_params.limit_ccw;
+        if (closed != contact.closed) {
+            contact.closed = closed;
+            contact.chatter = 2 * m_params.bounce_edges;
+            contact.next_toggle_us = at + m_params.bounce_us / (2 * m_params.bounce_edges + 1);
+            Toggle(limit, closed, woken);
+        }
+    }
+}
+
+void SimulatedBelt::Toggle(const Limit limit, const bool level, BaseType_t* woken)
+{
+    Contact& contact = ContactOf(limit);
+    if (contact.level == level) {
+        return;
+    }
+    contact.level = level;
+    if (m_limit_handler != nullptr) {
+        m_limit_handler(m_limit_context, limit, level, woken);
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <pico/time.h>
+
+#include "MotorIO.hpp"
+#include "StepGenerator.hpp"
+
+/// A curtain without one: the carriage moves a step for every step pulse the motor would have made,
+/// on the same schedule, and closes the limit switches where they would be. Switch bounce and lost
+/// steps can be dialled in. A repeating timer interrupt plays the role of the hardware, so the motor
+/// task sees the simulated edges the same way as real ones.
+class SimulatedBelt final : public MotorIO {
+public:
+    struct Parameters {
+        const char* name;
+
+        /// Steps between the hard stops at either end of the rail
+        int length;
+        /// The switches are closed at and beyond these positions, counted from the CW hard stop
+        int limit_cw;
+        int limit_ccw;
+        /// Carriage position at boot
+        int start;
+
+        /// Extra contact changes after every real one, spread over 'bounce_us'. Always settles.
+        uint8_t bounce_edges;
+        uint32_t bounce_us;
+        /// Every n-th step is lost, 0 for none
+        uint32_t missed_step_interval;
+    };
+
+    explicit SimulatedBelt(const Parameters& parameters);
+
+    void SetDirection(bool direction) override;
+    [[nodiscard]] bool IsLimitPressed(Limit limit) const override;
+    void SetLimitHandler(LimitHandler handler, void* context) override;
+
+    bool Push(const StepGenerator::Segment& segment) override;
+    uint32_t Collect() override;
+    uint32_t Abort() override;
+    void Freeze() override { m_frozen = true; }
+    [[nodiscard]] bool Idle() const override { return m_queued_count == 0; }
+    [[nodiscard]] bool Full() const override { return m_queued_count == StepGenerator::MAX_QUEUED; }
+    [[nodiscard]] uint32_t Pending() const override { return m_pending_steps; }
+
+    [[nodiscard]] const Parameters& GetParameters() const { return m_params; }
+    /// Carriage position in steps from the CW hard stop
+    [[nodiscard]] int Carriage() const;
+    /// Steps the motor took without moving the carriage: injected misses and pushing against a hard stop
+    [[nodiscard]] uint32_t LostSteps() const;
+    void SetMissedStepInterval(uint32_t interval);
+
+private:
+    struct Queued {
+        StepGenerator::Segment segment;
+        /// When the first step of the segment is due, set once it is the one running
+        uint32_t start_us;
+    };
+
+    struct Contact {
+        bool closed;
+        /// What the pin shows, which differs from 'closed' while the contacts bounce
+        bool level;
+        uint8_t chatter;
+        uint32_t next_toggle_us;
+    };
+
+    static bool OnTimer(repeating_timer_t* timer);
+    /// Plays the steps and contact changes due until 'now' in order
+    void Advance(uint32_t now, BaseType_t* woken);
+    void Step(uint32_t at, BaseType_t* woken);
+    void Toggle(Limit limit, bool level, BaseType_t* woken);
+    [[nodiscard]] Contact& ContactOf(Limit limit) { return m_contacts.at(limit == Limit::CW ? 0 : 1); }
+    [[nodiscard]] const Contact& ContactOf(Limit limit) const { return m_contacts.at(limit == Limit::CW ? 0 : 1); }
+    /// The segment stepping now, nullptr if none is
+    [[nodiscard]] Queued* Running();
+
+    static constexpr int64_t TIMER_PERIOD_US = 100;
+
+    Parameters m_params;
+    repeating_timer_t m_timer = {};
+
+    LimitHandler m_limit_handler = nullptr;
+    void* m_limit_context = nullptr;
+
+    /// Segments in the order given; the first 'm_finished' of them are done and wait for Collect()
+    std::array<Queued, StepGenerator::MAX_QUEUED> m_queued = {};
+    size_t m_queued_head = 0;
+    size_t m_queued_count = 0;
+    size_t m_finished = 0;
+    uint32_t m_pending_steps = 0;
+    /// Steps of the running segment taken so far
+    uint32_t m_running_steps = 0;
+    volatile bool m_frozen = false;
+
+    bool m_direction = true;
+    int m_carriage;
+    std::array<Contact, 2> m_contacts = {};
+    uint32_t m_step_count = 0;
+    uint32_t m_lost_steps = 0;
+};
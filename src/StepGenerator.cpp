@@ -0,0 +1,119 @@
+#include "StepGenerator.hpp"
+
+#include <hardware/clocks.h>
+
+#include "Logger.hpp"
+#include "StepGenerator.pio.h"
+
+std::array<int, 2> StepGenerator::s_offsets = { -1, -1 };
+
+StepGenerator::StepGenerator(const uint pin_step)
+{
+    // generators on the same PIO block share one copy of the program
+    for (const PIO pio : { pio0, pio1 }) {
+        int& offset = s_offsets.at(pio_get_index(pio));
+        if (offset < 0 && !pio_can_add_program(pio, &step_generator_program)) {
+            continue;
+        }
+        m_sm = pio_claim_unused_sm(pio, false);
+        if (m_sm >= 0) {
+            if (offset < 0) {
+                offset = static_cast<int>(pio_add_program(pio, &step_generator_program));
+            }
+            m_pio = pio;
+            m_offset = offset;
+            break;
+        }
+    }
+    if (m_pio == nullptr) {
+        Logger::Log("Error: No PIO state machine left for step generator on GPIO {}", pin_step);
+        return;
+    }
+
+    pio_sm_config config = step_generator_program_get_default_config(m_offset);
+    sm_config_set_sideset_pins(&config, pin_step);
+    sm_config_set_out_shift(&config, false, false, 32);
+    sm_config_set_clkdiv(&config, static_cast<float>(clock_get_hz(clk_sys)) / SM_CLOCK_HZ);
+    pio_gpio_init(m_pio, pin_step);
+    pio_sm_set_pins_with_mask(m_pio, m_sm, 0, 1u << pin_step);
+    pio_sm_set_consecutive_pindirs(m_pio, m_sm, pin_step, 1, true);
+    pio_sm_init(m_pio, m_sm, m_offset + step_generator_offset_start, &config);
+    pio_sm_set_enabled(m_pio, m_sm, true);
+    Logger::Log("Step generator on GPIO {} using PIO{} SM{}", pin_step, pio_get_index(m_pio), m_sm);
+}
+
+bool StepGenerator::Push(const Segment& segment)
+{
+    if (Full()) {
+        return false;
+    }
+    if (segment.steps == 0) {
+        return true;
+    }
+    for (const uint32_t word : Encode(segment)) {
+        pio_sm_put(m_pio, m_sm, word);
+    }
+    m_queued.at((m_queued_head + m_queued_count) % MAX_QUEUED) = segment;
+    ++m_queued_count;
+    m_pending_steps += segment.steps;
+    return true;
+}
+
+bool StepGenerator::Full() const
+{
+    return m_pio == nullptr || m_queued_count == MAX_QUEUED
+        || pio_sm_get_tx_fifo_level(m_pio, m_sm) > FIFO_WORDS - SEGMENT_WORDS;
+}
+
+uint32_t StepGenerator::Collect()
+{
+    uint32_t steps = 0;
+    while (m_queued_count != 0 && !pio_sm_is_rx_fifo_empty(m_pio, m_sm)) {
+        pio_sm_get(m_pio, m_sm);
+        steps += m_queued.at(m_queued_head).steps;
+        m_queued_head = (m_queued_head + 1) % MAX_QUEUED;
+        --m_queued_count;
+    }
+    m_pending_steps -= steps;
+    return steps;
+}
+
+uint32_t StepGenerator::Abort()
+{
+    if (m_pio == nullptr) {
+        return 0;
+    }
+    pio_sm_set_enabled(m_pio, m_sm, false);
+    uint32_t steps = Collect();
+    if (m_queued_count != 0) {
+        // the oldest queued segment may have been cut short
+        const uint pc = pio_sm_get_pc(m_pio, m_sm) - m_offset;
+        const uint32_t segment_steps = m_queued.at(m_queued_head).steps;
+        if (pc == step_generator_offset_done) {
+            steps += segment_steps;
+        } else if (pc >= step_generator_offset_step) {
+            // x counts down from steps - 1; at 'step' the pulse of the next step has not begun yet
+            pio_sm_exec(m_pio, m_sm, pio_encode_mov(pio_isr, pio_x));
+            pio_sm_exec(m_pio, m_sm, pio_encode_push(false, false));
+            const uint32_t remaining = pio_sm_get(m_pio, m_sm) + (pc == step_generator_offset_step ? 1 : 0);
+            steps += remaining < segment_steps ? segment_steps - remaining : 0;
+        }
+    }
+    pio_sm_clear_fifos(m_pio, m_sm);
+    pio_sm_restart(m_pio, m_sm);
+    pio_sm_exec(m_pio, m_sm, pio_encode_nop() | pio_encode_sideset_opt(1, 0));
+    pio_sm_exec(m_pio, m_sm, pio_encode_jmp(m_offset + step_generator_offset_start));
+    pio_sm_set_enabled(m_pio, m_sm, true);
+    m_queued_head = 0;
+    m_queued_count = 0;
+    m_pending_steps = 0;
+    return steps;
+}
+
+void StepGenerator::Freeze()
+{
+    if (m_pio != nullptr) {
+        // atomic alias rather than pio_sm_set_enabled(), as the interrupted task may be writing ctrl
+        hw_clear_bits(&m_pio->ctrl, 1u << (PIO_CTRL_SM_ENABLE_LSB + m_sm));
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <hardware/pio.h>
+
+/// Step pulses from a PIO state machine, fed with segments of equally spaced steps.
+/// The pulses keep their timing whatever the scheduler is doing; the owner only has to keep
+/// a segment queued ahead and collect the finished ones every now and then.
+class StepGenerator {
+public:
+    struct Segment {
+        uint32_t steps;
+        uint32_t period_us;
+    };
+
+    /// One state machine cycle per microsecond
+    static constexpr uint32_t SM_CLOCK_HZ = 1'000'000;
+    /// Cycles of every step spent outside the delay loops, see StepGenerator.pio
+    static constexpr uint32_t PERIOD_OVERHEAD_CYCLES = 5;
+    static constexpr uint32_t MIN_PERIOD_US = 20;
+    /// One segment executing and two waiting in the TX FIFO, once the state machine has pulled the first
+    static constexpr size_t MAX_QUEUED = 3;
+    /// TX FIFO depth without joining the RX FIFO
+    static constexpr uint FIFO_WORDS = 4;
+    static constexpr uint SEGMENT_WORDS = 2;
+
+    explicit StepGenerator(uint pin_step);
+
+    /// Returns false if Full()
+    bool Push(const Segment& segment);
+    /// Steps of the segments finished since the previous Collect()
+    uint32_t Collect();
+    /// Stops right away and drops everything queued. Returns the steps taken since the previous Collect().
+    uint32_t Abort();
+    /// Stops the pulses on the spot and leaves the accounting to Abort(). Safe to call from an interrupt.
+    void Freeze();
+
+    [[nodiscard]] bool Idle() const { return m_queued_count == 0; }
+    /// True with MAX_QUEUED segments queued, or while the TX FIFO has no room for the two words of
+    /// another one (right after a start the state machine may not have pulled the first segment yet).
+    /// Always true without a state machine.
+    [[nodiscard]] bool Full() const;
+    /// Steps queued and not collected yet
+    [[nodiscard]] uint32_t Pending() const { return m_pending_steps; }
+
+    /// The two FIFO words of a segment with at least one step
+    static constexpr std::array<uint32_t, SEGMENT_WORDS> Encode(const Segment& segment)
+    {
+        const uint32_t period = std::max(segment.period_us, MIN_PERIOD_US) * (SM_CLOCK_HZ / 1'000'000);
+        return { segment.steps - 1, (period - PERIOD_OVERHEAD_CYCLES) / 2 };
+    }
+
+private:
+    /// Where each PIO block holds the program, -1 until a generator loaded it there
+    static std::array<int, 2> s_offsets;
+
+    PIO m_pio = nullptr;
+    int m_sm = -1;
+    uint m_offset = 0;
+
+    /// Mirrors what the state machine has been given, oldest first
+    std::array<Segment, MAX_QUEUED> m_queued = {};
+    size_t m_queued_head = 0;
+    size_t m_queued_count = 0;
+    uint32_t m_pending_steps = 0;
+};
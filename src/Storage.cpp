@@ -1,5 +1,8 @@
 #include "Storage.hpp"
 
+#include <algorithm>
+#include <iterator>
+
 #include <FreeRTOS.h>
 #include <task.h>
 
@@ -12,9 +15,15 @@ RTOS::Semaphore* Storage::s_lux_target_auto = nullptr;
 Storage::Storage(const Parameters& parameters)
     : m_write_access(RTOS::Mutex { "FlashWriteAccess" })
     , m_lux_target(parameters.lux_target)
-    , m_http_notify(parameters.http_notify)
+    , m_notifier(parameters.notifier)
     , m_rtc(parameters.rtc)
+    , m_snapshot(AccessSettings())
 {
+    if (PendingMigration()) {
+        // right away rather than on the commit task: the record may lie in the journal area,
+        // and the journal erases its sectors from its first write on
+        m_dirty = !Program();
+    }
     if (xTaskCreate(
             TASK_KONDOM(Storage, Task),
             parameters.task_name,
@@ -27,6 +36,18 @@ Storage::Storage(const Parameters& parameters)
     } else {
         Logger::Log("Warning: Failed to create task [{}]", parameters.task_name);
     }
+    if (xTaskCreate(
+            TASK_KONDOM(Storage, CommitTask),
+            "StorageCommit",
+            TaskStackSize::STORAGE_COMMIT,
+            this,
+            TaskPriority::STORAGE_COMMIT,
+            &m_commit_handle)
+        == pdPASS) {
+        Logger::Log("Created task [StorageCommit]");
+    } else {
+        Logger::Log("Warning: Failed to create task [StorageCommit]");
+    }
     s_lux_target_auto = parameters.lux_target_auto;
     s_update_lux = parameters.update_lux_target;
 }
@@ -45,7 +66,25 @@ std::string Storage::StringifySettings(const Settings& settings)
         settings_str += fmt::format("\n - H{:0>2}: {:>6}", hour, settings.lux_targets[hour]);
     }
     settings_str += fmt::format("\n - Static: {:>6}", settings.lux_targets[Flash::LUX_STATIC]);
-    settings_str += fmt::format("\nStep Target: {:>3} %", settings.motor_target);
+    static constexpr const char* SCHEDULES[] = { "DAILY", "WEEKLY", "CURVE" };
+    settings_str += fmt::format("\nSchedule: {}", settings.schedule < std::size(SCHEDULES) ? SCHEDULES[settings.schedule] : "?");
+    if (settings.schedule == Flash::sWEEKLY) {
+        for (size_t day = 0; day < std::size(settings.weekly_targets); ++day) {
+            settings_str += fmt::format("\n - D{}:", day);
+            for (const auto lux : settings.weekly_targets[day]) {
+                settings_str += fmt::format(" {}", lux);
+            }
+        }
+    } else if (settings.schedule == Flash::sCURVE) {
+        for (size_t i = 0; i < std::min<size_t>(settings.curve_points, Flash::CURVE_CAPACITY); ++i) {
+            const Flash::Breakpoint& point = settings.curve[i];
+            settings_str += fmt::format("\n - {:0>2}:{:0>2}: {:>6}", point.minute / 60, point.minute % 60, point.lux);
+        }
+    }
+    for (size_t channel = 0; channel < MOTOR_CHANNELS; ++channel) {
+        const Flash::Channel& motor = settings.channels[channel];
+        settings_str += fmt::format("\nMotor {}: Step Target: {:>3} %, Belt: {} / {} steps", channel, motor.motor_target, motor.belt_position, motor.belt_max);
+    }
     return settings_str;
 }
 
@@ -54,7 +93,7 @@ void Storage::Task()
     Logger::Log("Initiated");
     {
         Settings flash_settings;
-        ReadOnlyAccessLocked(portMAX_DELAY, [&](const Settings& settings) {
+        ReadOnlyAccess([&](const Settings& settings) {
             flash_settings = settings;
             if (!(settings.sys_mode & bAUTO_HOURLY)) {
                 s_lux_target_auto->Take(0);
@@ -67,23 +106,87 @@ void Storage::Task()
     while (true) {
         s_update_lux->Take(portMAX_DELAY);
         const datetime_t time = m_rtc->GetDatetime();
-        const int8_t hour_A = time.hour;
-        const int8_t hour_B = time.hour < 23 ? hour_A + 1 : 00;
+        // any settings change moves the snapshot sequence; the table only needs a look then, or at midnight
+        const uint32_t sequence = m_snapshot_sequence.load(std::memory_order_acquire);
+        if (sequence != m_compiled_sequence || time.dotw != m_schedule.Day()) {
+            ReadOnlyAccess([&](const Settings& settings) {
+                if (const size_t rewritten = m_schedule.Compile(settings, time.dotw); rewritten != 0) {
+                    Logger::Log("Compiled lux schedule for day {} ({} minutes changed)", time.dotw, rewritten);
+                }
+            });
+            m_compiled_sequence = sequence;
+        }
+        const float new_target = m_schedule.TargetAt(time.hour, time.min);
 
-        float target_A = 0;
-        float target_B = 0;
+        m_lux_target->Overwrite(new_target);
+        Logger::Log("Updated Lux target to {}", new_target);
+        m_notifier->Publish(Notifier::bLUX);
+    }
+}
 
-        ReadOnlyAccessLocked(portMAX_DELAY, [&](const Settings& settings) {
-            target_A = settings.lux_targets[hour_A];
-            target_B = settings.lux_targets[hour_B];
-        });
+void Storage::MarkDirty() const
+{
+    m_dirty = true;
+    if (m_commit_handle != nullptr) {
+        xTaskNotifyGive(m_commit_handle);
+    }
+}
 
-        const float hour_fraction = static_cast<float>(time.min) / 60.0;
-        const float new_target = target_A * (1 - hour_fraction) + target_B * hour_fraction;
+Flash::Settings Storage::Snapshot() const
+{
+    Settings settings;
+    uint32_t sequence = 0;
+    do {
+        sequence = m_snapshot_sequence.load(std::memory_order_acquire);
+        settings = m_snapshot;
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) != 0 || m_snapshot_sequence.load(std::memory_order_relaxed) != sequence);
+    return settings;
+}
 
-        m_lux_target->Overwrite(new_target);
-        Logger::Log("Updated Lux target to {}", new_target);
-        m_http_notify->Give();
+void Storage::PublishSnapshot(const Settings& settings) const
+{
+    // a preempted writer would leave readers spinning on an odd sequence
+    taskENTER_CRITICAL();
+    const uint32_t sequence = m_snapshot_sequence.load(std::memory_order_relaxed);
+    m_snapshot_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_snapshot = settings;
+    m_snapshot_sequence.store(sequence + 2, std::memory_order_release);
+    taskEXIT_CRITICAL();
+}
+
+bool Storage::Flush() const
+{
+    m_write_access.Take(portMAX_DELAY);
+    if (m_dirty && Program()) {
+        m_dirty = false;
+    }
+    const bool flushed = !m_dirty;
+    m_write_access.Give();
+    return flushed;
+}
+
+void Storage::CommitTask()
+{
+    Logger::Log("Initiated");
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        const TickType_t first_change = xTaskGetTickCount();
+        while (true) {
+            const TickType_t elapsed = xTaskGetTickCount() - first_change;
+            if (elapsed >= COMMIT_MAX_DELAY) {
+                break;
+            }
+            if (ulTaskNotifyTake(pdTRUE, std::min(COMMIT_QUIET_PERIOD, COMMIT_MAX_DELAY - elapsed)) == 0) {
+                break;
+            }
+        }
+        if (!Flush() && Enabled()) {
+            // the record failed its check after programming; try again, a later change need not come
+            vTaskDelay(COMMIT_MAX_DELAY);
+            xTaskNotifyGive(xTaskGetCurrentTaskHandle());
+        }
     }
 }
 
@@ -110,24 +213,27 @@ void test_storage_task(void* params)
         new_settings.lux_targets[lux] = rand() % 1000;
     }
     new_settings.sys_mode = rand() % 4;
-    new_settings.motor_target = rand() % 101;
+    for (auto& channel : new_settings.channels) {
+        channel.motor_target = rand() % 101;
+    }
 
     Logger::Log("random settings\n{}", storage->StringifySettings(new_settings));
     vTaskDelay(pdMS_TO_TICKS(1000));
 
     Flash::Settings flash_settings {};
-    storage->ReadOnlyAccessLocked(portMAX_DELAY, [&](const Flash::Settings& settings) {
+    storage->ReadOnlyAccess([&](const Flash::Settings& settings) {
         flash_settings = settings;
     });
 
     Logger::Log("flash settings\n{}", storage->StringifySettings(flash_settings));
     vTaskDelay(pdMS_TO_TICKS(1000));
 
-    storage->WriteAccessAndProgramLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
+    storage->WriteAccessLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
         settings = new_settings;
     });
+    storage->Flush();
 
-    storage->ReadOnlyAccessLocked(portMAX_DELAY, [&](const Flash::Settings& settings) {
+    storage->ReadOnlyAccess([&](const Flash::Settings& settings) {
         flash_settings = settings;
     });
 
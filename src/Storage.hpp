@@ -1,8 +1,11 @@
 #pragma once
 
+#include <atomic>
 #include <mutex>
 
 #include "Flash.hpp"
+#include "LuxSchedule.hpp"
+#include "Notifier.hpp"
 #include "Queue.hpp"
 #include "RTC.hpp"
 #include "Semaphore.hpp"
@@ -16,42 +19,59 @@ public:
         RTOS::Semaphore* update_lux_target;
         RTOS::Semaphore* lux_target_auto;
         RTOS::Variable<float>* lux_target;
-        RTOS::Semaphore* http_notify;
+        Notifier* notifier;
 
         RTC* rtc;
     };
 
     explicit Storage(const Parameters& parameters);
 
+    /// Never blocks: the callback gets a consistent copy of the latest settings,
+    /// even while a writer or a flash commit is in progress.
     template <typename Callback>
-    bool ReadOnlyAccessLocked(const TickType_t wait_for_access, Callback&& callback) const
+    void ReadOnlyAccess(Callback&& callback) const
     {
-        if (!m_write_access.Take(wait_for_access)) {
-            return false;
-        }
-        const Settings& settings = AccessSettings();
+        const Settings settings = Snapshot();
         callback(settings);
-        m_write_access.Give();
-        return true;
     }
 
+    /// Changes only go to RAM, and only if the callback actually changed something. The commit
+    /// task programs flash once no write has arrived for COMMIT_QUIET_PERIOD, or COMMIT_MAX_DELAY
+    /// after the first uncommitted change at the latest. Writers serialize among themselves only.
     template <typename Callback>
-    bool WriteAccessAndProgramLocked(const TickType_t wait_for_access, Callback&& callback) const
+    bool WriteAccessLocked(const TickType_t wait_for_access, Callback&& callback) const
     {
         if (!m_write_access.Take(wait_for_access)) {
             return false;
         }
+        const Settings previous = AccessSettings();
         callback(AccessSettings());
-        Program();
-        m_http_notify->Give();
+        if (AccessSettings() != previous) {
+            PublishSnapshot(AccessSettings());
+            MarkDirty();
+            m_notifier->Publish(AccessSettings().sys_mode == previous.sys_mode
+                    ? Notifier::bSETTINGS
+                    : Notifier::bSETTINGS | Notifier::bMODE);
+        }
         m_write_access.Give();
         return true;
     }
 
+    /// Programs pending changes right away, e.g. before a reboot. False if they are still not in flash;
+    /// they stay pending for the next commit then.
+    bool Flush() const;
+
     static std::string StringifySettings(const Settings& settings);
 
 private:
     void Task();
+    void CommitTask();
+    void MarkDirty() const;
+    [[nodiscard]] Settings Snapshot() const;
+    void PublishSnapshot(const Settings& settings) const;
+
+    static constexpr TickType_t COMMIT_QUIET_PERIOD = pdMS_TO_TICKS(2'000);
+    static constexpr TickType_t COMMIT_MAX_DELAY = pdMS_TO_TICKS(10'000);
     static void AlarmEvent();
 
     static constexpr datetime_t ALARM_TIME = {
@@ -68,11 +88,22 @@ private:
     static RTOS::Semaphore* s_update_lux;
     static RTOS::Semaphore* s_lux_target_auto;
     RTOS::Variable<float>* m_lux_target;
-    RTOS::Semaphore* m_http_notify;
+    Notifier* m_notifier;
 
     RTC* m_rtc;
 
+    /// Guarded by m_write_access
+    mutable bool m_dirty = false;
+    /// Seqlock for readers: odd while PublishSnapshot() is copying
+    mutable std::atomic<uint32_t> m_snapshot_sequence = 0;
+    mutable Settings m_snapshot;
+
+    /// Only touched by Task()
+    LuxSchedule m_schedule;
+    uint32_t m_compiled_sequence = 0;
+
     TaskHandle_t m_handle = nullptr;
+    TaskHandle_t m_commit_handle = nullptr;
 };
 
 /// TODO: remove
@@ -2,6 +2,11 @@
 
 #include <FreeRTOS.h>
 
+/// Curtains driven by this controller, one Motor each; configure with -DMOTOR_CHANNELS=n
+#ifndef MOTOR_CHANNELS
+#define MOTOR_CHANNELS 1
+#endif
+
 #define DEFAULT_TASK_STACK_SIZE 256
 #define EXAMPLE_TASK_PRIORITY 1
 
@@ -9,9 +14,13 @@ namespace TaskPriority {
 using Type = BaseType_t;
 enum : Type {
     HTTP_SUB = 1,
+    HISTORY = 1,
     INDICATOR = 1,
     LOGGER = 1,
+    BENCHMARK = 2,
+    JOURNAL = 2,
     STORAGE = 2,
+    STORAGE_COMMIT = 2,
     ALS = 3,
     MOTOR = 3,
     CLI = 5,
@@ -23,14 +32,28 @@ namespace TaskStackSize {
 using Type = configSTACK_DEPTH_TYPE;
 enum : Type {
     HTTP_SUB = 1024,
+    HISTORY = 512,
     INDICATOR = 512,
+    BENCHMARK = 1024,
+    JOURNAL = 512,
     LOGGER = 1024,
     STORAGE = 1024,
+    STORAGE_COMMIT = 1024,
     ALS = 1024,
-    MOTOR = 512,
+    MOTOR = 768,
     CLI = 1024,
     W5500LWIP = 1536,
 };
 } // namespace TaskStackSize
 
+namespace TaskNotificationIndex {
+using Type = UBaseType_t;
+enum : Type {
+    /// xTaskNotifyGive(), ulTaskNotifyTake() and the rest of the unindexed API
+    DEFAULT = 0,
+    /// Motor::Post() completions of channel 0, MOTOR + n for channel n; see Motor::WaitForCompletion()
+    MOTOR = 1,
+};
+} // namespace TaskNotificationIndex
+
 #define TASK_KONDOM(klass, func) [](void* param) -> void { static_cast<klass*>(param)->func(); }
@@ -14,6 +14,18 @@
 #define LWIP_ALTCP_TLS           1
 #define LWIP_ALTCP_TLS_MBEDTLS   1
 
+/* Let reconnecting clients resume instead of doing a full ECDHE handshake:
+   server-side session cache for TLS 1.2 session IDs, and stateless session tickets */
+#define ALTCP_MBEDTLS_USE_SESSION_CACHE               1
+#define ALTCP_MBEDTLS_SESSION_CACHE_SIZE              4
+#define ALTCP_MBEDTLS_SESSION_CACHE_TIMEOUT_SECONDS   (60 * 60)
+#define ALTCP_MBEDTLS_USE_SESSION_TICKETS             1
+#define ALTCP_MBEDTLS_SESSION_TICKET_CIPHER           MBEDTLS_CIPHER_AES_128_GCM
+#define ALTCP_MBEDTLS_SESSION_TICKET_TIMEOUT_SECONDS  (60 * 60 * 24)
+
+/* mbedTLS allocates from the C heap through HttpServer's counting hooks, lwIP must not install its own */
+#define ALTCP_MBEDTLS_PLATFORM_ALLOC                  0
+
 #define LWIP_DEBUG 1
 #define ALTCP_MBEDTLS_DEBUG  LWIP_DBG_ON
 
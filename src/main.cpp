@@ -1,3 +1,4 @@
+#include <array>
 #include <functional>
 
 #include <FreeRTOS.h>
@@ -7,13 +8,19 @@
 
 #include "AmbientLightSensor.hpp"
 #include "CLI.hpp"
+#include "History.hpp"
 #include "HttpServer.hpp"
 #include "I2C.hpp"
 #include "Indicator.hpp"
 #include "Logger.hpp"
 #include "Motor.hpp"
+#include "MotorBenchmark.hpp"
+#include "MotorGPIO.hpp"
+#include "Notifier.hpp"
+#include "PositionJournal.hpp"
 #include "Primitive.hpp"
 #include "SPI.hpp"
+#include "SimulatedBelt.hpp"
 #include "Storage.hpp"
 #include "W5500LWIP.hpp"
 #include "config.h"
@@ -65,16 +72,17 @@ int main()
 
     /// Semaphores
     auto* control_auto = new RTOS::Semaphore { "ControlAuto" };
-    auto* http_notify = new RTOS::Semaphore { "HttpNotify" };
     auto* auto_hourly = new RTOS::Semaphore { "AutoHourly" };
     auto* update_hourly_lux_target = new RTOS::Semaphore { "UpdateLux" };
 
+    /// Notifications
+    auto* notifier = new Notifier();
+
     /// Variables
     auto* latest_measurement_als1 = new RTOS::Variable<LuxMeasurement> { "ALS-1-LatestMeasurement" };
     auto* latest_measurement_als2 = new RTOS::Variable<LuxMeasurement> { "ALS-2-LatestMeasurement" };
     auto* belt_position = new RTOS::Variable<uint8_t> { "BeltPosition" };
     auto* lux_target = new RTOS::Variable<float> { "LuxTarget" };
-    auto* motor_command = new RTOS::Variable<Motor::Command> { "MotorAction" };
 
     /// Tasks
     auto* storage = new Storage({
@@ -83,7 +91,7 @@ int main()
         .update_lux_target = update_hourly_lux_target,
         .lux_target_auto = auto_hourly,
         .lux_target = lux_target,
-        .http_notify = http_notify,
+        .notifier = notifier,
         .rtc = rtc,
     });
     auto* red = new Indicator({
@@ -91,11 +99,91 @@ int main()
         .pin = Indicator::GPIO::Pin17,
     });
     new Logger({ .task_name = "Logger" });
+    auto* journal = new PositionJournal({
+        .task_name = "Journal",
+
+        .checkpoint_steps = 500,
+        .checkpoint_interval = pdMS_TO_TICKS(1000),
+        .max_checkpoints_per_motion = 32,
+    });
+    /// Step, direction and limit switch pins of each channel; also names the motor tasks
+    static constexpr std::array<MotorGPIO::Parameters, Flash::MAX_MOTOR_CHANNELS> motor_gpio = { {
+        {
+            .name = "Motor",
+            .step = MotorGPIO::PinStep { 21 },
+            .direction = MotorGPIO::PinDirection { 20 },
+            .limit_cw = MotorGPIO::PinLimitCW { 19 },
+            .limit_ccw = MotorGPIO::PinLimitCCW { 18 },
+        },
+        {
+            .name = "Motor-1",
+            .step = MotorGPIO::PinStep { 22 },
+            .direction = MotorGPIO::PinDirection { 26 },
+            .limit_cw = MotorGPIO::PinLimitCW { 27 },
+            .limit_ccw = MotorGPIO::PinLimitCCW { 28 },
+        },
+        {
+            .name = "Motor-2",
+            .step = MotorGPIO::PinStep { 6 },
+            .direction = MotorGPIO::PinDirection { 11 },
+            .limit_cw = MotorGPIO::PinLimitCW { 13 },
+            .limit_ccw = MotorGPIO::PinLimitCCW { 14 },
+        },
+    } };
+    MotorChannels motors = {};
+    for (uint8_t channel = 0; channel < MOTOR_CHANNELS; ++channel) {
+        const char* name = motor_gpio.at(channel).name;
+#if MOTOR_SIMULATION
+        auto* belt = new SimulatedBelt({
+            .name = name,
+
+            .length = 10'400,
+            .limit_cw = 200,
+            .limit_ccw = 10'200,
+            .start = 4'000,
+
+            .bounce_edges = 3,
+            .bounce_us = 2'000,
+            .missed_step_interval = 0,
+        });
+        MotorIO* motor_io = belt;
+#else
+        MotorIO* motor_io = new MotorGPIO(motor_gpio.at(channel));
+#endif
+        motors.at(channel) = new Motor({
+            .name = name,
+            .channel = channel,
+
+            .io = motor_io,
+
+            // start speed is the rate the motor used to run at without acceleration; see tools/motion_sim.cpp
+            .move_profile = { .start_speed = 500, .max_speed = 2'000, .acceleration = 2'000, .jerk = 20'000 },
+            .calibration_profile = { .start_speed = 500, .max_speed = 800, .acceleration = 1'000, .jerk = 0 },
+
+            .s_control_auto = control_auto,
+            // the history has room for one curtain
+            .v_belt_position = channel == 0 ? belt_position : nullptr,
+            .notifier = notifier,
+            .storage = storage,
+            .journal = journal,
+            .red = red,
+        });
+#if MOTOR_SIMULATION
+        static constexpr std::array<const char*, Flash::MAX_MOTOR_CHANNELS> benchmark_names = { "Benchmark", "Benchmark-1", "Benchmark-2" };
+        new MotorBenchmark({
+            .task_name = benchmark_names.at(channel),
+
+            .motor = motors.at(channel),
+            .belt = belt,
+            .s_control_auto = control_auto,
+        });
+#endif
+    }
     new CLI({
         .task_name = "CLI",
 
         .v_lux_target = lux_target,
-        .v_motor_command = motor_command,
+        .motors = motors,
         .s_control_auto = control_auto,
         .s_auto_hourly = auto_hourly,
         .storage = storage,
@@ -112,37 +200,32 @@ int main()
         .v_latest_measurement_als2 = latest_measurement_als2,
 
         .v_lux_target = lux_target,
-        .v_motor_command = motor_command,
+        .motors = motors,
         .s_control_auto = control_auto,
-        .s_http_notify = http_notify,
+        .notifier = notifier,
         .red = red,
     });
-    auto* motor = new Motor({
-        .name = "Motor",
+    auto* history = new History({
+        .task_name = "History",
 
-        .step = Motor::PinStep { 21 },
-        .direction = Motor::PinDirection { 20 },
-        .limit_cw = Motor::PinLimitCW { 19 },
-        .limit_ccw = Motor::PinLimitCCW { 18 },
-
-        .v_command = motor_command,
-        .s_control_auto = control_auto,
+        .v_latest_measurement_als1 = latest_measurement_als1,
+        .v_latest_measurement_als2 = latest_measurement_als2,
+        .v_lux_target = lux_target,
         .v_belt_position = belt_position,
-        .s_http_notify = http_notify,
-        .storage = storage,
-        .red = red,
+        .rtc = rtc,
     });
     auto* http = new HttpServer({
         .port = 80,
-        .motor = motor,
+        .tls_port = 443,
+        .motors = motors,
         .als1 = latest_measurement_als1,
         .als2 = latest_measurement_als2,
-        .notify = http_notify,
-        .motor_command = motor_command,
+        .notifier = notifier,
         .lux_target = lux_target,
         .control_auto = control_auto,
         .auto_hourly = auto_hourly,
         .storage = storage,
+        .history = history,
         .rtc = rtc,
     });
     late_main([spi_1, http, red]() {
@@ -159,7 +242,7 @@ int main()
 
     Logger::Log("Semaphores: {}", RTOS::Implementation::Primitive::GetSemaphoreCount());
     Logger::Log("Queues: {}", RTOS::Implementation::Primitive::GetQueueCount());
-    Logger::Log("Initializing Scheduler...");
+    Logger::Log("Initializing Scheduler... ({} us after boot)", time_us_32());
     sleep_us(1); // Ensure RTOS delay functionality
     vTaskStartScheduler();
 }
@@ -11,18 +11,11 @@
 #define MBEDTLS_HAVE_TIME
 
 #define MBEDTLS_CIPHER_MODE_CBC
-#define MBEDTLS_ECP_DP_SECP192R1_ENABLED
-#define MBEDTLS_ECP_DP_SECP224R1_ENABLED
+/* Curves are offered in this order, so P-256 (with the NIST fast reduction) is the common case */
 #define MBEDTLS_ECP_DP_SECP256R1_ENABLED
 #define MBEDTLS_ECP_DP_SECP384R1_ENABLED
-#define MBEDTLS_ECP_DP_SECP521R1_ENABLED
-#define MBEDTLS_ECP_DP_SECP192K1_ENABLED
-#define MBEDTLS_ECP_DP_SECP224K1_ENABLED
-#define MBEDTLS_ECP_DP_SECP256K1_ENABLED
-#define MBEDTLS_ECP_DP_BP256R1_ENABLED
-#define MBEDTLS_ECP_DP_BP384R1_ENABLED
-#define MBEDTLS_ECP_DP_BP512R1_ENABLED
 #define MBEDTLS_ECP_DP_CURVE25519_ENABLED
+#define MBEDTLS_ECP_NIST_OPTIM
 #define MBEDTLS_KEY_EXCHANGE_RSA_ENABLED
 #define MBEDTLS_PKCS1_V15
 #define MBEDTLS_SHA256_SMALLER
@@ -41,6 +34,7 @@
 #define MBEDTLS_PK_C
 #define MBEDTLS_PK_PARSE_C
 #define MBEDTLS_PLATFORM_C
+#define MBEDTLS_PLATFORM_MEMORY
 #define MBEDTLS_RSA_C
 #define MBEDTLS_SHA1_C
 #define MBEDTLS_SHA224_C
@@ -63,6 +57,19 @@
 #define MBEDTLS_ECDSA_C
 #define MBEDTLS_ASN1_WRITE_C
 
+/* Session resumption for the HTTPS listener */
+#define MBEDTLS_SSL_CACHE_C
+#define MBEDTLS_SSL_TICKET_C
+#define MBEDTLS_SSL_SESSION_TICKETS
+
+/* Server preference order: ECDHE-ECDSA first, static RSA key exchange only as a last resort */
+#define MBEDTLS_SSL_CIPHERSUITES                         \
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,     \
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256,     \
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,       \
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256,       \
+    MBEDTLS_TLS_RSA_WITH_AES_128_GCM_SHA256
+
 // The following is needed to parse a certificate
 #define MBEDTLS_PEM_PARSE_C
 #define MBEDTLS_BASE64_C
@@ -0,0 +1,99 @@
+/// Host measurement of how long a jog command takes to move the curtain, the two ways a client can
+/// send one: a /ws command, which only posts to the motor, and POST /settings with a manual target,
+/// which changes the settings under the write lock and posts from inside it, leaving flash to the
+/// commit task. Each runs what its handler does once the request is parsed, one path after the
+/// other, from standstill on the simulated belt, and is timed to the 1 ms tick until the carriage
+/// takes its first step. Also counts the settings records each path has programmed. The TCP
+/// connection, parsing and response are not part of it: the HTTP stack does not build on the host.
+///
+///   cmake -S tools -B build-tools && cmake --build build-tools && build-tools/command_latency
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include <task.h>
+
+#include "host/Curtain.hpp"
+#include "host/Host.hpp"
+
+namespace {
+constexpr int COMMANDS = 20;
+
+struct Path {
+    const char* name;
+    void (*issue)(const Curtain& curtain, uint8_t percent);
+    std::vector<uint64_t> latency_us;
+    uint32_t records;
+};
+
+/// HttpConnection::HandleWebSocketCommand() given "g<percent>"
+void Jog(const Curtain& curtain, const uint8_t percent)
+{
+    if (curtain.GetMotor().CurrentCommand() == Motor::CALIBRATE) {
+        return;
+    }
+    curtain.ControlAuto().Take(0);
+    curtain.GetMotor().Post(Motor::Command { percent });
+}
+
+/// HttpConnection::HandlePOST() given {"motor_target": percent} in manual mode
+void PostSettings(const Curtain& curtain, const uint8_t percent)
+{
+    curtain.GetStorage().WriteAccessLocked(portMAX_DELAY, [&](Flash::Settings& settings) {
+        settings.channels[0].motor_target = static_cast<int8_t>(percent);
+        curtain.GetMotor().Post(Motor::Command { percent });
+    });
+}
+
+uint64_t Measure(const Curtain& curtain, const Path& path, const uint8_t percent)
+{
+    const int carriage = curtain.GetBelt().Carriage();
+    const uint64_t start = Host::Now();
+    path.issue(curtain, percent);
+    while (curtain.GetBelt().Carriage() == carriage) {
+        vTaskDelay(1);
+    }
+    const uint64_t latency = Host::Now() - start;
+    while (curtain.GetMotor().CurrentCommand() != Motor::STOP) {
+        vTaskDelay(1);
+    }
+    return latency;
+}
+
+uint64_t Percentile(std::vector<uint64_t> values, const size_t percent)
+{
+    std::sort(values.begin(), values.end());
+    return values.at((values.size() * percent + 99) / 100 - 1);
+}
+} // namespace
+
+int main()
+{
+    Host::EchoLog(false);
+    Curtain curtain;
+    Path paths[] = {
+        { "/ws", Jog, {}, 0 },
+        { "POST /settings", PostSettings, {}, 0 },
+    };
+    curtain.Run([&] {
+        for (Path& path : paths) {
+            const uint32_t records = curtain.GetStorage().GetStatistics().records;
+            for (int command = 0; command < COMMANDS; ++command) {
+                // a jog back and forth between 20 and 80 %, the distance varying
+                const auto percent = static_cast<uint8_t>(command % 2 == 0 ? 20 + command : 80 - command);
+                path.latency_us.push_back(Measure(curtain, path, percent));
+            }
+            // long enough for the commit task to program whatever is still pending
+            vTaskDelay(pdMS_TO_TICKS(11'000));
+            path.records = curtain.GetStorage().GetStatistics().records - records;
+        }
+    });
+
+    std::printf("%-16s %8s %8s %8s %8s %8s\n", "command", "count", "p50 ms", "p99 ms", "max ms", "records");
+    for (const Path& path : paths) {
+        std::printf("%-16s %8zu %8.1f %8.1f %8.1f %8u\n", path.name, path.latency_us.size(), Percentile(path.latency_us, 50) / 1000.0,
+            Percentile(path.latency_us, 99) / 1000.0, *std::max_element(path.latency_us.begin(), path.latency_us.end()) / 1000.0,
+            path.records);
+    }
+}
@@ -0,0 +1,92 @@
+/// Host simulation of the settings log in Flash: programs a stream of settings updates into a
+/// simulated flash chip and reports the sector erases and the flash busy time each one costs,
+/// next to the erase-and-rewrite of both A/B copies that the log replaced.
+///
+///   cmake -S tools -B build-tools && cmake --build build-tools && build-tools/flash_sim [updates] [--each]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Flash.hpp"
+#include "host/Host.hpp"
+
+namespace {
+class SettingsStore final : public Flash {
+public:
+    using Flash::AccessSettings;
+    using Flash::Program;
+};
+
+/// The settings region is the top quarter of flash, see settings_guard.ld; the log ends where the journal begins
+constexpr ptrdiff_t LOG_BOTTOM = PICO_FLASH_SIZE_BYTES * 3 / 4;
+
+/// What a settings change used to cost: both copies erased and one page programmed into each
+constexpr uint64_t AB_UPDATE_US = 2 * (Host::SECTOR_ERASE_US + Host::PAGE_PROGRAM_US);
+
+/// Mostly position saves, as every stop of the motor makes one, with a lux target change now and then
+void Change(Flash::Settings& settings, const int update)
+{
+    if (update % 10 == 0) {
+        settings.lux_targets[update % 24] += 1.0f;
+    } else {
+        settings.channels[0].belt_position = static_cast<uint16_t>(update * 37 % 10'000);
+    }
+}
+}
+
+int main(int argc, char** argv)
+{
+    const int updates = argc > 1 ? std::atoi(argv[1]) : 10'000;
+    const bool each = argc > 2 && std::strcmp(argv[2], "--each") == 0;
+    Host::EchoLog(false);
+    Host::EraseFlash();
+
+    auto* store = new SettingsStore();
+    uint32_t updates_with_erase = 0;
+    uint32_t failed = 0;
+    uint64_t worst_us = 0;
+    const Host::FlashCounters start = Host::GetFlashCounters();
+    for (int update = 1; update <= updates; ++update) {
+        const Host::FlashCounters before = Host::GetFlashCounters();
+        Change(store->AccessSettings(), update);
+        failed += store->Program() ? 0 : 1;
+        const Host::FlashCounters after = Host::GetFlashCounters();
+        const uint64_t busy_us = after.busy_us - before.busy_us;
+        worst_us = std::max(worst_us, busy_us);
+        updates_with_erase += after.erases != before.erases ? 1 : 0;
+        if (each) {
+            std::printf("update %6d: %u erases, %3u pages, %6.1f ms\n", update, after.erases - before.erases, after.pages - before.pages, busy_us / 1000.0);
+        }
+    }
+    const Host::FlashCounters end = Host::GetFlashCounters();
+    const Flash::Settings expected = store->AccessSettings();
+    delete store;
+
+    uint32_t worst_sector = 0;
+    uint32_t journal_erases = 0;
+    for (ptrdiff_t sector = LOG_BOTTOM; sector < Flash::JOURNAL_TOP; sector += FLASH_SECTOR_SIZE) {
+        if (sector < Flash::JOURNAL_BOTTOM) {
+            worst_sector = std::max(worst_sector, Host::SectorErases(sector));
+        } else {
+            journal_erases += Host::SectorErases(sector);
+        }
+    }
+
+    // a reboot has to come back with the last update
+    auto* rebooted = new SettingsStore();
+    const bool recovered = rebooted->AccessSettings() == expected;
+    delete rebooted;
+
+    const uint32_t erases = end.erases - start.erases;
+    const uint64_t busy_us = end.busy_us - start.busy_us;
+    std::printf("%d updates over %td log sectors\n", updates, (Flash::JOURNAL_BOTTOM - LOG_BOTTOM) / FLASH_SECTOR_SIZE);
+    std::printf("  erases:      %u total, %.4f per update, %u updates erased a sector\n", erases, static_cast<double>(erases) / updates, updates_with_erase);
+    std::printf("  wear:        %u erases on the most worn sector, %u in the journal area\n", worst_sector, journal_erases);
+    std::printf("  flash busy:  %.2f ms per update on average, %.2f ms at worst\n", busy_us / 1000.0 / updates, worst_us / 1000.0);
+    std::printf("  A/B copies:  %.2f ms and 2 erases per update, %d erases on each of the two sectors\n", AB_UPDATE_US / 1000.0, updates);
+    std::printf("  failed:      %u updates not programmed\n", failed);
+    std::printf("  after reboot: %s\n", recovered ? "last update recovered" : "MISMATCH");
+    return recovered && failed == 0 && journal_erases == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,125 @@
+/// Host simulation of Motor::Calibrate() on the simulated belt: from a spread of start positions,
+/// the calibration at boot and a second one from the same place. Reports the time each took next to
+/// creeping the same distance at the constant 2 ms step of the old motor task, and how repeatable
+/// the result is: the belt length found and the position error right after. Last, a belt whose
+/// switches both read closed, on which the calibration has to give up rather than back off forever.
+///
+///   cmake -S tools -B build-tools && cmake --build build-tools && build-tools/homing_sim [bounce edges]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include <sys/wait.h>
+#include <task.h>
+
+#include "host/Curtain.hpp"
+#include "host/Host.hpp"
+
+namespace {
+constexpr uint32_t CONSTANT_PERIOD_US = 2'000;
+constexpr int RUNS = 20;
+/// Real seconds a run may take before it counts as hung
+constexpr unsigned RUN_TIMEOUT_S = 60;
+
+struct Calibration {
+    uint32_t ms;
+    int max;
+    int error;
+};
+
+struct Result {
+    int start; /// carriage, in steps from the CW hard stop
+    uint32_t creep_ms;
+    Calibration boot;
+    Calibration again;
+    uint32_t lost;
+};
+
+Calibration Measure(const Curtain& curtain, const uint32_t ms)
+{
+    return { .ms = ms, .max = curtain.GetMotor().GetPosition().max, .error = curtain.PositionError() };
+}
+
+/// Every run boots a fresh controller, so it gets a process of its own
+Result Run(SimulatedBelt::Parameters belt)
+{
+    Result result = { .start = belt.start };
+    int pipe_ends[2];
+    if (pipe(pipe_ends) != 0) {
+        std::perror("pipe");
+        std::exit(1);
+    }
+    if (fork() == 0) {
+        close(pipe_ends[0]);
+        alarm(RUN_TIMEOUT_S);
+        Host::EchoLog(false);
+        Curtain curtain(belt);
+        curtain.Run([&] {
+            result.boot = Measure(curtain, Host::Now() / 1000);
+            // back to where it booted, then calibrate again with the length known
+            const int from = belt.start - belt.limit_cw;
+            curtain.Execute(Motor::Steps(std::clamp(from, 0, result.boot.max)));
+            result.again = Measure(curtain, curtain.Execute(Motor::CALIBRATE));
+            result.lost = curtain.GetBelt().LostSteps();
+        });
+        // run to the open switch, then to the closed one
+        const int travel = std::abs(belt.start - belt.limit_cw) + (belt.limit_ccw - belt.limit_cw);
+        result.creep_ms = travel * CONSTANT_PERIOD_US / 1000;
+        write(pipe_ends[1], &result, sizeof(result));
+        _exit(0);
+    }
+    close(pipe_ends[1]);
+    if (read(pipe_ends[0], &result, sizeof(result)) != sizeof(result)) {
+        std::fprintf(stderr, "Run from %d failed or hung\n", belt.start);
+        std::exit(1);
+    }
+    close(pipe_ends[0]);
+    wait(nullptr);
+    return result;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    SimulatedBelt::Parameters belt = Curtain::BELT;
+    if (argc > 1) {
+        belt.bounce_edges = std::atoi(argv[1]);
+    }
+
+    std::printf("%6s %9s | %9s %6s %6s | %9s %6s %6s | %5s\n", "start", "2 ms s", "boot s", "max", "error", "again s", "max", "error", "lost");
+    double creep_s = 0;
+    double boot_s = 0;
+    double again_s = 0;
+    int min_max = belt.length;
+    int max_max = 0;
+    int worst_error = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        // both ends, beyond the switches, and everything inbetween
+        belt.start = run * belt.length / (RUNS - 1);
+        const Result result = Run(belt);
+        std::printf("%6d %9.2f | %9.2f %6d %6d | %9.2f %6d %6d | %5u\n", result.start, result.creep_ms / 1000.0,
+            result.boot.ms / 1000.0, result.boot.max, result.boot.error,
+            result.again.ms / 1000.0, result.again.max, result.again.error, result.lost);
+        creep_s += result.creep_ms / 1000.0;
+        boot_s += result.boot.ms / 1000.0;
+        again_s += result.again.ms / 1000.0;
+        for (const Calibration& calibration : { result.boot, result.again }) {
+            min_max = std::min(min_max, calibration.max);
+            max_max = std::max(max_max, calibration.max);
+            worst_error = std::max(worst_error, std::abs(calibration.error));
+        }
+    }
+    std::printf("\naverage over %d runs: 2 ms creep %.2f s, boot %.2f s, again %.2f s\n", RUNS, creep_s / RUNS, boot_s / RUNS, again_s / RUNS);
+    std::printf("belt length found: %d - %d steps, worst position error after calibrating: %d steps\n", min_max, max_max, worst_error);
+
+    // a shorted harness: the switches overlap, so the carriage sits on both
+    SimulatedBelt::Parameters shorted = belt;
+    shorted.limit_cw = belt.length / 2 + 1'000;
+    shorted.limit_ccw = belt.length / 2 - 1'000;
+    shorted.start = belt.length / 2;
+    const Result result = Run(shorted);
+    std::printf("both switches closed: boot gave up after %.2f s with max %d\n", result.boot.ms / 1000.0, result.boot.max);
+    return result.boot.max == 0 && result.again.max == 0 ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+#include "Curtain.hpp"
+
+#include <hardware/timer.h>
+#include <task.h>
+
+#include "Host.hpp"
+#include "config.h"
+
+Curtain::Curtain(const SimulatedBelt::Parameters& belt)
+{
+    Host::EraseFlash();
+    auto* rtc = new RTC();
+    m_notifier = new Notifier();
+    m_control_auto = new RTOS::Semaphore { "ControlAuto" };
+    m_storage = new Storage({
+        .task_name = "Storage",
+
+        .update_lux_target = new RTOS::Semaphore { "UpdateLux" },
+        .lux_target_auto = new RTOS::Semaphore { "AutoHourly" },
+        .lux_target = new RTOS::Variable<float> { "LuxTarget" },
+        .notifier = m_notifier,
+        .rtc = rtc,
+    });
+    auto* red = new Indicator({
+        .task_name = "ERROR",
+        .pin = Indicator::GPIO::Pin17,
+    });
+    auto* journal = new PositionJournal({
+        .task_name = "Journal",
+
+        .checkpoint_steps = 500,
+        .checkpoint_interval = pdMS_TO_TICKS(1000),
+        .max_checkpoints_per_motion = 32,
+    });
+    m_belt = new SimulatedBelt(belt);
+    m_motor = new Motor({
+        .name = belt.name,
+        .channel = 0,
+
+        .io = m_belt,
+
+        .move_profile = { .start_speed = 500, .max_speed = 2'000, .acceleration = 2'000, .jerk = 20'000 },
+        .calibration_profile = { .start_speed = 500, .max_speed = 800, .acceleration = 1'000, .jerk = 0 },
+
+        .s_control_auto = m_control_auto,
+        .v_belt_position = new RTOS::Variable<uint8_t> { "BeltPosition" },
+        .notifier = m_notifier,
+        .storage = m_storage,
+        .journal = journal,
+        .red = red,
+    });
+}
+
+void Curtain::Run(std::function<void()> script)
+{
+    m_script = std::move(script);
+    xTaskCreate(
+        [](void* param) -> void {
+            auto* curtain = static_cast<Curtain*>(param);
+            // the boot calibration has no issuer to tell, so poll for its end
+            while (curtain->m_motor->CurrentCommand() != Motor::STOP) {
+                vTaskDelay(pdMS_TO_TICKS(1));
+            }
+            curtain->m_control_auto->Take(0);
+            curtain->m_script();
+            vTaskEndScheduler();
+        },
+        "Script", TaskStackSize::BENCHMARK, this, TaskPriority::BENCHMARK, nullptr);
+    vTaskStartScheduler();
+}
+
+uint32_t Curtain::Execute(const Motor::Command command) const
+{
+    const uint64_t start = time_us_64();
+    m_motor->WaitForCompletion(m_motor->Post(command, xTaskGetCurrentTaskHandle()), portMAX_DELAY);
+    while (m_motor->CurrentCommand() == Motor::CALIBRATE) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    // a finished calibration hands the motor back to the automatic control
+    m_control_auto->Take(0);
+    return (time_us_64() - start) / 1000;
+}
+
+int Curtain::PositionError() const
+{
+    return m_motor->GetPosition().steps - (m_belt->Carriage() - m_belt->GetParameters().limit_cw);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <functional>
+
+#include "Motor.hpp"
+#include "SimulatedBelt.hpp"
+#include "Storage.hpp"
+
+/// Motor channel 0 on a SimulatedBelt with everything it talks to, wired up the way main.cpp does
+/// with MOTOR_SIMULATION, over an erased flash chip. Nothing runs until Run() starts the scheduler.
+class Curtain {
+public:
+    /// The belt main.cpp simulates
+    static constexpr SimulatedBelt::Parameters BELT = {
+        .name = "Motor",
+
+        .length = 10'400,
+        .limit_cw = 200,
+        .limit_ccw = 10'200,
+        .start = 4'000,
+
+        .bounce_edges = 3,
+        .bounce_us = 2'000,
+        .missed_step_interval = 0,
+    };
+
+    explicit Curtain(const SimulatedBelt::Parameters& belt = BELT);
+
+    /// Runs the firmware tasks and 'script' as a task of its own, which starts once the calibration
+    /// the motor does at boot is over. Returns when 'script' does.
+    void Run(std::function<void()> script);
+
+    [[nodiscard]] Motor& GetMotor() const { return *m_motor; }
+    [[nodiscard]] SimulatedBelt& GetBelt() const { return *m_belt; }
+    [[nodiscard]] RTOS::Semaphore& ControlAuto() const { return *m_control_auto; }
+    [[nodiscard]] Notifier& GetNotifier() const { return *m_notifier; }
+    [[nodiscard]] Storage& GetStorage() const { return *m_storage; }
+
+    /// Posts 'command' from the calling task and waits for it, including any recalibration the
+    /// motor starts on its own. Returns the simulated milliseconds it took.
+    uint32_t Execute(Motor::Command command) const;
+    /// Motor position minus where the carriage is, both counted from the CW switch
+    [[nodiscard]] int PositionError() const;
+
+private:
+    Notifier* m_notifier;
+    RTOS::Semaphore* m_control_auto;
+    Storage* m_storage;
+    SimulatedBelt* m_belt;
+    Motor* m_motor;
+    std::function<void()> m_script;
+};
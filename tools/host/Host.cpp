@@ -0,0 +1,154 @@
+#include "Host.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include <boards/pico_w.h>
+#include <hardware/dma.h>
+#include <hardware/flash.h>
+#include <hardware/rtc.h>
+#include <hardware/timer.h>
+#include <pico/flash.h>
+#include <task.h>
+
+#include "Logger.hpp"
+
+extern "C" {
+alignas(FLASH_SECTOR_SIZE) uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+}
+// Flash::SettingsMemoryIsSafe() looks at where the image ends; pretend it is 256 KiB
+asm(".globl __flash_binary_end\n.set __flash_binary_end, host_flash + 0x40000");
+
+namespace {
+uint64_t s_now_us = 0;
+Host::FlashCounters s_flash = {};
+std::array<uint32_t, PICO_FLASH_SIZE_BYTES / FLASH_SECTOR_SIZE> s_sector_erases = {};
+bool s_echo_log = true;
+datetime_t s_rtc = {};
+}
+
+uint64_t Host::Now()
+{
+    return s_now_us;
+}
+
+void Host::Advance(const uint64_t us)
+{
+    s_now_us += us;
+}
+
+Host::FlashCounters Host::GetFlashCounters()
+{
+    return s_flash;
+}
+
+uint32_t Host::SectorErases(const ptrdiff_t address)
+{
+    return s_sector_erases.at(address / FLASH_SECTOR_SIZE);
+}
+
+void Host::EraseFlash()
+{
+    std::memset(host_flash, 0xFF, sizeof(host_flash));
+}
+
+void Host::EchoLog(const bool echo)
+{
+    s_echo_log = echo;
+}
+
+uint64_t time_us_64()
+{
+    return s_now_us;
+}
+
+uint32_t time_us_32()
+{
+    return static_cast<uint32_t>(s_now_us);
+}
+
+void flash_range_erase(const uint32_t flash_offs, const size_t count)
+{
+    assert(flash_offs % FLASH_SECTOR_SIZE == 0 && count % FLASH_SECTOR_SIZE == 0);
+    assert(flash_offs + count <= PICO_FLASH_SIZE_BYTES);
+    std::memset(host_flash + flash_offs, 0xFF, count);
+    for (size_t sector = flash_offs / FLASH_SECTOR_SIZE; sector < (flash_offs + count) / FLASH_SECTOR_SIZE; ++sector) {
+        ++s_sector_erases.at(sector);
+        ++s_flash.erases;
+        s_flash.busy_us += Host::SECTOR_ERASE_US;
+        s_now_us += Host::SECTOR_ERASE_US;
+    }
+}
+
+void flash_range_program(const uint32_t flash_offs, const uint8_t* data, const size_t count)
+{
+    assert(flash_offs % FLASH_PAGE_SIZE == 0 && count % FLASH_PAGE_SIZE == 0);
+    assert(flash_offs + count <= PICO_FLASH_SIZE_BYTES);
+    // NOR flash only ever clears bits; programming over old data leaves the AND of both
+    for (size_t i = 0; i < count; ++i) {
+        host_flash[flash_offs + i] &= data[i];
+    }
+    const uint32_t pages = count / FLASH_PAGE_SIZE;
+    s_flash.pages += pages;
+    s_flash.busy_us += pages * Host::PAGE_PROGRAM_US;
+    s_now_us += pages * Host::PAGE_PROGRAM_US;
+}
+
+int flash_safe_execute(void (*func)(void*), void* param, uint32_t enter_exit_timeout_ms)
+{
+    (void)enter_exit_timeout_ms;
+    func(param);
+    return 0;
+}
+
+int dma_claim_unused_channel(const bool required)
+{
+    assert(!required);
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel) { }
+dma_channel_config dma_channel_get_default_config(uint channel) { return {}; }
+void channel_config_set_transfer_data_size(dma_channel_config* c, dma_channel_transfer_size size) { }
+void channel_config_set_read_increment(dma_channel_config* c, bool incr) { }
+void channel_config_set_write_increment(dma_channel_config* c, bool incr) { }
+void channel_config_set_sniff_enable(dma_channel_config* c, bool sniff_enable) { }
+void dma_channel_configure(uint channel, const dma_channel_config* config, volatile void* write_addr, const volatile void* read_addr, uint transfer_count, bool trigger) { }
+void dma_channel_wait_for_finish_blocking(uint channel) { }
+void dma_sniffer_enable(uint channel, uint mode, bool force_channel_enable) { }
+void dma_sniffer_disable() { }
+void dma_sniffer_set_data_accumulator(uint32_t seed_value) { }
+uint32_t dma_sniffer_get_data_accumulator() { return 0; }
+
+// The clock stands still at what it was set to, and its alarm never goes off
+void rtc_init() { }
+
+bool rtc_set_datetime(datetime_t* t)
+{
+    s_rtc = *t;
+    return true;
+}
+
+bool rtc_get_datetime(datetime_t* t)
+{
+    *t = s_rtc;
+    return true;
+}
+
+void rtc_set_alarm(datetime_t* t, rtc_callback_t user_callback) { }
+void rtc_enable_alarm() { }
+void rtc_disable_alarm() { }
+
+void Logger::LogMessage(std::string&& msg)
+{
+    if (!s_echo_log) {
+        return;
+    }
+    if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING && xTaskGetCurrentTaskHandle() != nullptr) {
+        std::printf("[%10.3f ms] [%s] %s\n", s_now_us / 1000.0, pcTaskGetName(nullptr), msg.c_str());
+    } else {
+        std::printf("[%10.3f ms] %s\n", s_now_us / 1000.0, msg.c_str());
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include <FreeRTOS.h>
+
+/// Runs firmware sources on the host: simulated time, a simulated flash chip, the FreeRTOS kernel
+/// and the few SDK functions they call. The headers in tools/host/include stand in for the SDK ones.
+namespace Host {
+/// Simulated microseconds since start. Only Advance(), flash operations and the scheduler waiting
+/// for the next event move it, so results do not depend on how fast the host is.
+uint64_t Now();
+void Advance(uint64_t us);
+
+/// Typical timings of the W25Q16JV on the Pico W
+constexpr uint32_t SECTOR_ERASE_US = 45'000;
+constexpr uint32_t PAGE_PROGRAM_US = 400;
+
+struct FlashCounters {
+    uint32_t erases;
+    uint32_t pages; /// programmed
+    uint64_t busy_us; /// simulated time spent erasing and programming
+};
+[[nodiscard]] FlashCounters GetFlashCounters();
+/// Erases of the sector holding 'address' since start
+[[nodiscard]] uint32_t SectorErases(ptrdiff_t address);
+/// Makes the whole chip read 0xFF, like a new one; the counters carry on
+void EraseFlash();
+
+/// A task created under 'name' and not deleted since, nullptr if there is none. See Kernel.cpp.
+[[nodiscard]] TaskHandle_t FindTask(const char* name);
+/// How often 'task' called each kernel function so far; nullptr for the timer callbacks
+[[nodiscard]] std::map<std::string, uint32_t> KernelCalls(TaskHandle_t task);
+
+/// Logger::Log() output goes to stdout with the simulated time, unless turned off
+void EchoLog(bool echo);
+}
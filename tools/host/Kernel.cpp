@@ -0,0 +1,768 @@
+// The FreeRTOS API on simulated time. Every task is a thread, but only one of them runs at a time and
+// they only switch inside kernel calls, the way a single core without time slicing would. Once every
+// task is blocked, the idle loop moves the clock to the next timeout or timer alarm and runs the alarm
+// callbacks there, which is where the firmware's interrupts happen.
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <FreeRTOS.h>
+#include <event_groups.h>
+#include <pico/time.h>
+#include <queue.h>
+#include <semphr.h>
+#include <task.h>
+
+#include "host/Host.hpp"
+
+struct HostTask {
+    enum class State {
+        READY,
+        BLOCKED,
+        SUSPENDED,
+        DELETED,
+    };
+    enum class Notification : uint8_t {
+        NOT_WAITING,
+        WAITING,
+        RECEIVED,
+    };
+
+    std::string name;
+    UBaseType_t priority;
+    State state = State::READY;
+    /// When a blocked task times out
+    uint64_t wake_us = 0;
+    /// Unblocks the task early, checked whenever the scheduler looks for the next task to run
+    std::function<bool()> ready_when;
+    /// Orders tasks of equal priority: the one that waited longest runs first
+    uint64_t last_run = 0;
+    std::condition_variable turn;
+
+    std::array<uint32_t, configTASK_NOTIFICATION_ARRAY_ENTRIES> notification_value = {};
+    std::array<Notification, configTASK_NOTIFICATION_ARRAY_ENTRIES> notification_state = {};
+
+    std::map<std::string, uint32_t> kernel_calls;
+};
+
+struct HostQueue {
+    enum class Kind {
+        QUEUE,
+        SEMAPHORE,
+        MUTEX,
+        RECURSIVE_MUTEX,
+    };
+
+    Kind kind;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    /// Semaphores hold empty items, one per count
+    std::deque<std::vector<uint8_t>> items;
+    TaskHandle_t holder = nullptr;
+    UBaseType_t depth = 0;
+};
+
+struct HostEventGroup {
+    EventBits_t bits = 0;
+};
+
+namespace {
+struct Alarm {
+    repeating_timer_t* timer;
+    uint64_t due_us;
+};
+
+constexpr uint64_t TICK_US = 1'000'000 / configTICK_RATE_HZ;
+constexpr uint64_t NEVER = std::numeric_limits<uint64_t>::max();
+
+// never destroyed: tasks left blocked when the program ends still wait on them
+auto& s_lock = *new std::mutex;
+auto& s_tasks = *new std::vector<HostTask*>;
+auto& s_alarms = *new std::vector<Alarm>;
+auto* s_idle = new HostTask { .name = "IDLE", .priority = 0 };
+HostTask* s_current = nullptr;
+BaseType_t s_scheduler_state = taskSCHEDULER_NOT_STARTED;
+bool s_end = false;
+uint64_t s_switches = 0;
+int32_t s_alarm_ids = 0;
+
+/// Tallies the kernel function for the calling task, or for the idle loop if it is a timer callback
+void Count(const char* function)
+{
+    ++(s_current != nullptr ? s_current : s_idle)->kernel_calls[function];
+}
+
+uint64_t Deadline(const TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? NEVER : (Host::Now() / TICK_US + ticks) * TICK_US;
+}
+
+bool Runnable(const HostTask* task)
+{
+    return task->state == HostTask::State::READY;
+}
+
+/// Readies the blocked tasks whose wait is over and returns the one to run next
+HostTask* PickNext()
+{
+    HostTask* next = s_idle;
+    for (HostTask* task : s_tasks) {
+        if (task->state == HostTask::State::BLOCKED && (task->wake_us <= Host::Now() || (task->ready_when && task->ready_when()))) {
+            task->state = HostTask::State::READY;
+        }
+        if (!Runnable(task)) {
+            continue;
+        }
+        // the running task keeps the core against others of its priority
+        if (next == s_idle || task->priority > next->priority
+            || (task->priority == next->priority && next != s_current && (task == s_current || task->last_run < next->last_run))) {
+            next = task;
+        }
+    }
+    return next;
+}
+
+void HandOver(HostTask* self, HostTask* next)
+{
+    std::unique_lock lock(s_lock);
+    next->last_run = ++s_switches;
+    s_current = next;
+    next->turn.notify_one();
+    self->turn.wait(lock, [self] { return s_current == self; });
+}
+
+/// Lets a task of higher priority that was just readied, or the next one if the caller blocked, run
+void Schedule()
+{
+    if (s_scheduler_state != taskSCHEDULER_RUNNING || s_current == s_idle) {
+        return;
+    }
+    HostTask* self = s_current;
+    HostTask* next = PickNext();
+    if (next != self) {
+        HandOver(self, next);
+    }
+}
+
+/// Blocks the calling task until 'ready' holds, for at most 'wait' ticks. Returns whether it holds.
+bool Block(const std::function<bool()>& ready, const TickType_t wait)
+{
+    if (ready && ready()) {
+        return true;
+    }
+    if (wait == 0) {
+        return false;
+    }
+    assert(s_scheduler_state == taskSCHEDULER_RUNNING && s_current != s_idle);
+    HostTask* self = s_current;
+    const uint64_t deadline = Deadline(wait);
+    while (true) {
+        self->state = HostTask::State::BLOCKED;
+        self->wake_us = deadline;
+        self->ready_when = ready;
+        Schedule();
+        self->ready_when = nullptr;
+        // another task may have taken what woke this one in the meantime
+        if (ready && ready()) {
+            return true;
+        }
+        if (Host::Now() >= deadline) {
+            return false;
+        }
+    }
+}
+
+/// Moves the clock to the next timeout or alarm and runs the alarms due. False if there is none.
+bool AdvanceToNextEvent()
+{
+    uint64_t next = NEVER;
+    for (const HostTask* task : s_tasks) {
+        if (task->state == HostTask::State::BLOCKED) {
+            next = std::min(next, task->wake_us);
+        }
+    }
+    for (const Alarm& alarm : s_alarms) {
+        next = std::min(next, alarm.due_us);
+    }
+    if (next == NEVER) {
+        return false;
+    }
+    if (next > Host::Now()) {
+        Host::Advance(next - Host::Now());
+    }
+    while (true) {
+        const auto due = std::min_element(s_alarms.begin(), s_alarms.end(), [](const Alarm& a, const Alarm& b) { return a.due_us < b.due_us; });
+        if (due == s_alarms.end() || due->due_us > Host::Now()) {
+            return true;
+        }
+        Alarm alarm = *due;
+        s_alarms.erase(due);
+        if (alarm.timer->callback(alarm.timer)) {
+            alarm.due_us += static_cast<uint64_t>(std::abs(alarm.timer->delay_us));
+            s_alarms.push_back(alarm);
+        }
+    }
+}
+
+HostTask* TaskOf(TaskHandle_t task)
+{
+    return task != nullptr ? task : s_current;
+}
+
+BaseType_t Send(QueueHandle_t queue, const void* item, const TickType_t wait, const bool front)
+{
+    if (!Block([queue] { return queue->items.size() < queue->length; }, wait)) {
+        return pdFALSE;
+    }
+    std::vector<uint8_t> bytes(queue->item_size);
+    if (item != nullptr) {
+        std::memcpy(bytes.data(), item, queue->item_size);
+    }
+    if (front) {
+        queue->items.push_front(std::move(bytes));
+    } else {
+        queue->items.push_back(std::move(bytes));
+    }
+    return pdTRUE;
+}
+
+BaseType_t Receive(QueueHandle_t queue, void* item, const TickType_t wait, const bool remove)
+{
+    if (!Block([queue] { return !queue->items.empty(); }, wait)) {
+        return pdFALSE;
+    }
+    if (item != nullptr) {
+        std::memcpy(item, queue->items.front().data(), queue->item_size);
+    }
+    if (remove) {
+        queue->items.pop_front();
+    }
+    return pdTRUE;
+}
+
+QueueHandle_t CreateQueue(const HostQueue::Kind kind, const UBaseType_t length, const UBaseType_t item_size, const UBaseType_t count)
+{
+    auto* queue = new HostQueue { .kind = kind, .length = length, .item_size = item_size };
+    queue->items.resize(count);
+    return queue;
+}
+
+BaseType_t Notify(TaskHandle_t task, const UBaseType_t index, const uint32_t value, const eNotifyAction action, uint32_t* previous_value, BaseType_t* woken)
+{
+    uint32_t& notification = task->notification_value.at(index);
+    HostTask::Notification& state = task->notification_state.at(index);
+    if (previous_value != nullptr) {
+        *previous_value = notification;
+    }
+    if (action == eSetValueWithoutOverwrite && state == HostTask::Notification::RECEIVED) {
+        return pdFAIL;
+    }
+    switch (action) {
+    case eNoAction:
+        break;
+    case eSetBits:
+        notification |= value;
+        break;
+    case eIncrement:
+        ++notification;
+        break;
+    case eSetValueWithOverwrite:
+    case eSetValueWithoutOverwrite:
+        notification = value;
+        break;
+    }
+    if (state == HostTask::Notification::WAITING && woken != nullptr) {
+        *woken = pdTRUE;
+    }
+    state = HostTask::Notification::RECEIVED;
+    return pdPASS;
+}
+
+bool EventBitsSet(const HostEventGroup* group, const EventBits_t bits, const BaseType_t wait_for_all)
+{
+    return wait_for_all == pdTRUE ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+}
+}
+
+TaskHandle_t Host::FindTask(const char* name)
+{
+    const auto task = std::find_if(s_tasks.begin(), s_tasks.end(), [name](const HostTask* task) {
+        return task->name == name && task->state != HostTask::State::DELETED;
+    });
+    return task != s_tasks.end() ? *task : nullptr;
+}
+
+std::map<std::string, uint32_t> Host::KernelCalls(TaskHandle_t task)
+{
+    return (task != nullptr ? task : s_idle)->kernel_calls;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, configSTACK_DEPTH_TYPE stack_depth, void* parameters, UBaseType_t priority, TaskHandle_t* created)
+{
+    (void)stack_depth;
+    auto* task = new HostTask { .name = name, .priority = priority };
+    s_tasks.push_back(task);
+    if (created != nullptr) {
+        *created = task;
+    }
+    std::thread([task, code, parameters] {
+        {
+            std::unique_lock lock(s_lock);
+            task->turn.wait(lock, [task] { return s_current == task; });
+        }
+        code(parameters);
+        // a FreeRTOS task must not return; treat it as deleting itself
+        vTaskDelete(nullptr);
+    }).detach();
+    Schedule();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    Count(__func__);
+    HostTask* deleted = TaskOf(task);
+    deleted->state = HostTask::State::DELETED;
+    if (deleted == s_current) {
+        // never handed the core again, so the thread stays parked in there
+        HandOver(deleted, PickNext());
+    }
+}
+
+void vTaskSuspend(TaskHandle_t task)
+{
+    Count(__func__);
+    TaskOf(task)->state = HostTask::State::SUSPENDED;
+    Schedule();
+}
+
+void vTaskResume(TaskHandle_t task)
+{
+    Count(__func__);
+    if (task->state == HostTask::State::SUSPENDED) {
+        task->state = HostTask::State::READY;
+        Schedule();
+    }
+}
+
+void vTaskDelay(const TickType_t ticks)
+{
+    Count(__func__);
+    if (ticks == 0) {
+        Schedule();
+        return;
+    }
+    Block(nullptr, ticks);
+}
+
+BaseType_t xTaskDelayUntil(TickType_t* previous_wake, const TickType_t increment)
+{
+    Count(__func__);
+    const TickType_t now = xTaskGetTickCount();
+    const TickType_t wake = *previous_wake + increment;
+    *previous_wake = wake;
+    if (static_cast<int32_t>(wake - now) <= 0) {
+        return pdFALSE;
+    }
+    Block(nullptr, wake - now);
+    return pdTRUE;
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return static_cast<TickType_t>(Host::Now() / TICK_US);
+}
+
+TickType_t xTaskGetTickCountFromISR()
+{
+    return xTaskGetTickCount();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return s_current != s_idle ? s_current : nullptr;
+}
+
+const char* pcTaskGetName(TaskHandle_t task)
+{
+    return TaskOf(task)->name.c_str();
+}
+
+BaseType_t xTaskGetSchedulerState()
+{
+    return s_scheduler_state;
+}
+
+void vTaskStartScheduler()
+{
+    s_scheduler_state = taskSCHEDULER_RUNNING;
+    s_end = false;
+    s_current = s_idle;
+    while (true) {
+        HostTask* next = PickNext();
+        if (next != s_idle) {
+            HandOver(s_idle, next);
+        }
+        // back here once every task is blocked, or one of them ended the scheduler
+        if (s_end || !AdvanceToNextEvent()) {
+            break;
+        }
+    }
+    s_current = nullptr;
+    s_scheduler_state = taskSCHEDULER_NOT_STARTED;
+}
+
+void vTaskEndScheduler()
+{
+    s_end = true;
+    if (s_current != nullptr && s_current != s_idle) {
+        HostTask* self = s_current;
+        self->state = HostTask::State::SUSPENDED;
+        HandOver(self, s_idle);
+    }
+}
+
+BaseType_t xTaskGenericNotify(TaskHandle_t task, const UBaseType_t index, const uint32_t value, const eNotifyAction action, uint32_t* previous_value)
+{
+    Count(__func__);
+    const BaseType_t result = Notify(task, index, value, action, previous_value, nullptr);
+    Schedule();
+    return result;
+}
+
+BaseType_t xTaskGenericNotifyFromISR(TaskHandle_t task, const UBaseType_t index, const uint32_t value, const eNotifyAction action, uint32_t* previous_value, BaseType_t* woken)
+{
+    Count(__func__);
+    return Notify(task, index, value, action, previous_value, woken);
+}
+
+BaseType_t xTaskGenericNotifyWait(const UBaseType_t index, const uint32_t clear_on_entry, const uint32_t clear_on_exit, uint32_t* value, const TickType_t wait)
+{
+    Count(__func__);
+    HostTask* self = s_current;
+    uint32_t& notification = self->notification_value.at(index);
+    HostTask::Notification& state = self->notification_state.at(index);
+    if (state != HostTask::Notification::RECEIVED) {
+        notification &= ~clear_on_entry;
+        state = HostTask::Notification::WAITING;
+    }
+    const bool received = Block([&state] { return state == HostTask::Notification::RECEIVED; }, wait);
+    if (value != nullptr) {
+        *value = notification;
+    }
+    if (received) {
+        notification &= ~clear_on_exit;
+    }
+    state = HostTask::Notification::NOT_WAITING;
+    return received ? pdTRUE : pdFALSE;
+}
+
+uint32_t ulTaskGenericNotifyTake(const UBaseType_t index, const BaseType_t clear_on_exit, const TickType_t wait)
+{
+    Count(__func__);
+    HostTask* self = s_current;
+    uint32_t& notification = self->notification_value.at(index);
+    HostTask::Notification& state = self->notification_state.at(index);
+    if (notification == 0) {
+        state = HostTask::Notification::WAITING;
+        Block([&state] { return state == HostTask::Notification::RECEIVED; }, wait);
+    }
+    const uint32_t taken = notification;
+    if (taken != 0) {
+        notification = clear_on_exit == pdTRUE ? 0 : taken - 1;
+    }
+    state = HostTask::Notification::NOT_WAITING;
+    return taken;
+}
+
+void vTaskGenericNotifyGiveFromISR(TaskHandle_t task, const UBaseType_t index, BaseType_t* woken)
+{
+    Count(__func__);
+    Notify(task, index, 0, eIncrement, nullptr, woken);
+}
+
+QueueHandle_t xQueueCreate(const UBaseType_t length, const UBaseType_t item_size)
+{
+    return CreateQueue(HostQueue::Kind::QUEUE, length, item_size, 0);
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    delete queue;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, const TickType_t wait)
+{
+    Count(__func__);
+    const BaseType_t sent = Send(queue, item, wait, false);
+    Schedule();
+    return sent;
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, const TickType_t wait)
+{
+    Count(__func__);
+    const BaseType_t sent = Send(queue, item, wait, true);
+    Schedule();
+    return sent;
+}
+
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken)
+{
+    Count(__func__);
+    return Send(queue, item, 0, false);
+}
+
+BaseType_t xQueueSendToFrontFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken)
+{
+    Count(__func__);
+    return Send(queue, item, 0, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item)
+{
+    Count(__func__);
+    assert(queue->length == 1);
+    queue->items.clear();
+    Send(queue, item, 0, false);
+    Schedule();
+    return pdPASS;
+}
+
+BaseType_t xQueueOverwriteFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken)
+{
+    Count(__func__);
+    assert(queue->length == 1);
+    queue->items.clear();
+    return Send(queue, item, 0, false);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, const TickType_t wait)
+{
+    Count(__func__);
+    const BaseType_t received = Receive(queue, item, wait, true);
+    Schedule();
+    return received;
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t queue, void* item, BaseType_t* woken)
+{
+    Count(__func__);
+    return Receive(queue, item, 0, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, const TickType_t wait)
+{
+    Count(__func__);
+    return Receive(queue, item, wait, false);
+}
+
+BaseType_t xQueuePeekFromISR(QueueHandle_t queue, void* item)
+{
+    Count(__func__);
+    return Receive(queue, item, 0, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    Count(__func__);
+    queue->items.clear();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->items.size();
+}
+
+UBaseType_t uxQueueMessagesWaitingFromISR(QueueHandle_t queue)
+{
+    return queue->items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+    return CreateQueue(HostQueue::Kind::SEMAPHORE, 1, 0, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(const UBaseType_t max_count, const UBaseType_t initial_count)
+{
+    return CreateQueue(HostQueue::Kind::SEMAPHORE, max_count, 0, initial_count);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return CreateQueue(HostQueue::Kind::MUTEX, 1, 0, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex()
+{
+    return CreateQueue(HostQueue::Kind::RECURSIVE_MUTEX, 1, 0, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, const TickType_t wait)
+{
+    Count(__func__);
+    if (Receive(semaphore, nullptr, wait, true) == pdFALSE) {
+        return pdFALSE;
+    }
+    if (semaphore->kind == HostQueue::Kind::MUTEX) {
+        semaphore->holder = s_current;
+    }
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    Count(__func__);
+    if (semaphore->kind == HostQueue::Kind::MUTEX) {
+        if (semaphore->holder != s_current) {
+            return pdFALSE;
+        }
+        semaphore->holder = nullptr;
+    }
+    const BaseType_t given = Send(semaphore, nullptr, 0, false);
+    Schedule();
+    return given;
+}
+
+BaseType_t xSemaphoreTakeFromISR(SemaphoreHandle_t semaphore, BaseType_t* woken)
+{
+    Count(__func__);
+    return Receive(semaphore, nullptr, 0, true);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* woken)
+{
+    Count(__func__);
+    return Send(semaphore, nullptr, 0, false);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, const TickType_t wait)
+{
+    Count(__func__);
+    if (mutex->holder == s_current && mutex->depth != 0) {
+        ++mutex->depth;
+        return pdTRUE;
+    }
+    if (Receive(mutex, nullptr, wait, true) == pdFALSE) {
+        return pdFALSE;
+    }
+    mutex->holder = s_current;
+    mutex->depth = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex)
+{
+    Count(__func__);
+    if (mutex->holder != s_current || mutex->depth == 0) {
+        return pdFALSE;
+    }
+    if (--mutex->depth == 0) {
+        mutex->holder = nullptr;
+        Send(mutex, nullptr, 0, false);
+        Schedule();
+    }
+    return pdTRUE;
+}
+
+TaskHandle_t xSemaphoreGetMutexHolder(SemaphoreHandle_t mutex)
+{
+    return mutex->holder;
+}
+
+TaskHandle_t xSemaphoreGetMutexHolderFromISR(SemaphoreHandle_t mutex)
+{
+    return mutex->holder;
+}
+
+EventGroupHandle_t xEventGroupCreate()
+{
+    return new HostEventGroup;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, const EventBits_t bits)
+{
+    Count(__func__);
+    group->bits |= bits;
+    const EventBits_t set = group->bits;
+    Schedule();
+    return set;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, const EventBits_t bits)
+{
+    Count(__func__);
+    const EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, const EventBits_t bits, const BaseType_t clear_on_exit, const BaseType_t wait_for_all, const TickType_t wait)
+{
+    Count(__func__);
+    const bool set = Block([group, bits, wait_for_all] { return EventBitsSet(group, bits, wait_for_all); }, wait);
+    const EventBits_t result = group->bits;
+    if (set && clear_on_exit == pdTRUE) {
+        group->bits &= ~bits;
+    }
+    return result;
+}
+
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t group, const EventBits_t bits, BaseType_t* woken)
+{
+    Count(__func__);
+    // FreeRTOS defers this to the timer task; setting them right away is what that ends up doing
+    group->bits |= bits;
+    return pdPASS;
+}
+
+bool add_repeating_timer_us(const int64_t delay_us, const repeating_timer_callback_t callback, void* user_data, repeating_timer_t* out)
+{
+    *out = { .delay_us = delay_us, .pool = nullptr, .alarm_id = ++s_alarm_ids, .callback = callback, .user_data = user_data };
+    s_alarms.push_back({ .timer = out, .due_us = Host::Now() + static_cast<uint64_t>(std::abs(delay_us)) });
+    return true;
+}
+
+bool cancel_repeating_timer(repeating_timer_t* timer)
+{
+    const auto alarm = std::find_if(s_alarms.begin(), s_alarms.end(), [timer](const Alarm& alarm) { return alarm.timer == timer; });
+    if (alarm == s_alarms.end()) {
+        return false;
+    }
+    s_alarms.erase(alarm);
+    return true;
+}
+
+size_t xPortGetFreeHeapSize()
+{
+    return 0;
+}
+
+size_t xPortGetMinimumEverFreeHeapSize()
+{
+    return 0;
+}
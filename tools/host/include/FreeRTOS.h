@@ -0,0 +1,39 @@
+#pragma once
+
+// Just enough of the FreeRTOS API for the firmware sources the host tools build
+
+#include <cstddef>
+#include <cstdint>
+
+using uint = unsigned int;
+using TickType_t = uint32_t;
+using BaseType_t = long;
+using UBaseType_t = unsigned long;
+using TaskHandle_t = struct HostTask*;
+using QueueHandle_t = struct HostQueue*;
+using SemaphoreHandle_t = QueueHandle_t;
+using EventGroupHandle_t = struct HostEventGroup*;
+using EventBits_t = uint32_t;
+using TaskFunction_t = void (*)(void*);
+
+#include "FreeRTOSConfig.h"
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFu)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((TickType_t)(ms) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+#define tskIDLE_PRIORITY ((UBaseType_t)0U)
+
+// Tasks only switch inside kernel calls and timer callbacks only run while every task is blocked,
+// so a critical section has nothing to keep out
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+#define taskENTER_CRITICAL_FROM_ISR() ((UBaseType_t)0)
+#define taskEXIT_CRITICAL_FROM_ISR(saved) ((void)(saved))
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
+
+size_t xPortGetFreeHeapSize();
+size_t xPortGetMinimumEverFreeHeapSize();
@@ -0,0 +1,3 @@
+#pragma once
+
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
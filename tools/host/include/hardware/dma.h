@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+using uint = unsigned int;
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2,
+};
+struct dma_channel_config {
+    uint32_t ctrl;
+};
+#define DMA_SNIFF_CTRL_CALC_VALUE_CRC16 0x2
+
+/// There is no DMA on the host; claiming a channel always fails
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint channel);
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config* c, dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config* c, bool incr);
+void channel_config_set_write_increment(dma_channel_config* c, bool incr);
+void channel_config_set_sniff_enable(dma_channel_config* c, bool sniff_enable);
+void dma_channel_configure(uint channel, const dma_channel_config* config, volatile void* write_addr, const volatile void* read_addr, uint transfer_count, bool trigger);
+void dma_channel_wait_for_finish_blocking(uint channel);
+void dma_sniffer_enable(uint channel, uint mode, bool force_channel_enable);
+void dma_sniffer_disable();
+void dma_sniffer_set_data_accumulator(uint32_t seed_value);
+uint32_t dma_sniffer_get_data_accumulator();
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+using uint = unsigned int;
+
+enum gpio_function {
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_PWM = 4,
+};
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+/// Pins go nowhere on the host
+inline void gpio_init(uint gpio) { }
+inline void gpio_set_dir(uint gpio, bool out) { }
+inline void gpio_put(uint gpio, bool value) { }
+inline void gpio_set_function(uint gpio, gpio_function fn) { }
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstdint>
+
+using uint = unsigned int;
+
+/// Only the type; the host has no state machines, SimulatedBelt stands in for them
+using PIO = struct pio_hw_t*;
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+#include <hardware/gpio.h>
+
+struct pwm_config {
+    uint32_t csr;
+    uint32_t div;
+    uint32_t top;
+};
+
+inline uint pwm_gpio_to_slice_num(uint gpio) { return (gpio >> 1u) & 7u; }
+inline uint pwm_gpio_to_channel(uint gpio) { return gpio & 1u; }
+inline pwm_config pwm_get_default_config() { return {}; }
+inline void pwm_config_set_clkdiv_int(pwm_config* c, uint div) { c->div = div; }
+inline void pwm_config_set_wrap(pwm_config* c, uint16_t wrap) { c->top = wrap; }
+inline void pwm_init(uint slice_num, pwm_config* c, bool start) { }
+inline void pwm_set_enabled(uint slice_num, bool enabled) { }
+inline void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level) { }
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+/// The simulated flash, see tools/host/Host.hpp
+extern "C" uint8_t host_flash[];
+#define XIP_BASE (reinterpret_cast<uintptr_t>(host_flash))
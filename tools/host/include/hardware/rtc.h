@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+struct datetime_t {
+    int16_t year;
+    int8_t month;
+    int8_t day;
+    int8_t dotw;
+    int8_t hour;
+    int8_t min;
+    int8_t sec;
+};
+using rtc_callback_t = void (*)();
+
+void rtc_init();
+bool rtc_set_datetime(datetime_t* t);
+bool rtc_get_datetime(datetime_t* t);
+void rtc_set_alarm(datetime_t* t, rtc_callback_t user_callback);
+void rtc_enable_alarm();
+void rtc_disable_alarm();
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+/// Simulated time, see tools/host/Host.hpp
+uint64_t time_us_64();
+uint32_t time_us_32();
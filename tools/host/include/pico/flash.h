@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstdint>
+
+/// Runs 'func' right away; there is no XIP or second core to keep out
+int flash_safe_execute(void (*func)(void*), void* param, uint32_t enter_exit_timeout_ms);
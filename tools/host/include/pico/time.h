@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+#include <hardware/timer.h>
+
+/// Alarms fire on simulated time, from the host scheduler's idle loop; see tools/host/Kernel.cpp
+using repeating_timer_t = struct repeating_timer;
+using repeating_timer_callback_t = bool (*)(repeating_timer_t* rt);
+struct repeating_timer {
+    int64_t delay_us;
+    void* pool;
+    int32_t alarm_id;
+    repeating_timer_callback_t callback;
+    void* user_data;
+};
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void* user_data, repeating_timer_t* out);
+bool cancel_repeating_timer(repeating_timer_t* timer);
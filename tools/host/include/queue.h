@@ -0,0 +1,19 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t wait);
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t wait);
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken);
+BaseType_t xQueueSendToFrontFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item);
+BaseType_t xQueueOverwriteFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait);
+BaseType_t xQueueReceiveFromISR(QueueHandle_t queue, void* item, BaseType_t* woken);
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t wait);
+BaseType_t xQueuePeekFromISR(QueueHandle_t queue, void* item);
+BaseType_t xQueueReset(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaitingFromISR(QueueHandle_t queue);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "queue.h"
+
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTakeFromISR(SemaphoreHandle_t semaphore, BaseType_t* woken);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* woken);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t wait);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex);
+TaskHandle_t xSemaphoreGetMutexHolder(SemaphoreHandle_t mutex);
+TaskHandle_t xSemaphoreGetMutexHolderFromISR(SemaphoreHandle_t mutex);
+#define vSemaphoreDelete(semaphore) vQueueDelete(semaphore)
+#define uxSemaphoreGetCount(semaphore) uxQueueMessagesWaiting(semaphore)
+#define uxSemaphoreGetCountFromISR(semaphore) uxQueueMessagesWaitingFromISR(semaphore)
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+enum eNotifyAction {
+    eNoAction,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite,
+};
+
+#define taskSCHEDULER_SUSPENDED ((BaseType_t)0)
+#define taskSCHEDULER_NOT_STARTED ((BaseType_t)1)
+#define taskSCHEDULER_RUNNING ((BaseType_t)2)
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, configSTACK_DEPTH_TYPE stack_depth, void* parameters, UBaseType_t priority, TaskHandle_t* created);
+void vTaskDelete(TaskHandle_t task);
+void vTaskSuspend(TaskHandle_t task);
+void vTaskResume(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+BaseType_t xTaskDelayUntil(TickType_t* previous_wake, TickType_t increment);
+#define vTaskDelayUntil(previous_wake, increment) ((void)xTaskDelayUntil((previous_wake), (increment)))
+TickType_t xTaskGetTickCount();
+TickType_t xTaskGetTickCountFromISR();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+const char* pcTaskGetName(TaskHandle_t task);
+BaseType_t xTaskGetSchedulerState();
+void vTaskStartScheduler();
+void vTaskEndScheduler();
+
+BaseType_t xTaskGenericNotify(TaskHandle_t task, UBaseType_t index, uint32_t value, eNotifyAction action, uint32_t* previous_value);
+BaseType_t xTaskGenericNotifyFromISR(TaskHandle_t task, UBaseType_t index, uint32_t value, eNotifyAction action, uint32_t* previous_value, BaseType_t* woken);
+BaseType_t xTaskGenericNotifyWait(UBaseType_t index, uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t wait);
+uint32_t ulTaskGenericNotifyTake(UBaseType_t index, BaseType_t clear_on_exit, TickType_t wait);
+void vTaskGenericNotifyGiveFromISR(TaskHandle_t task, UBaseType_t index, BaseType_t* woken);
+
+#define xTaskNotify(task, value, action) xTaskGenericNotify((task), 0, (value), (action), nullptr)
+#define xTaskNotifyIndexed(task, index, value, action) xTaskGenericNotify((task), (index), (value), (action), nullptr)
+#define xTaskNotifyFromISR(task, value, action, woken) xTaskGenericNotifyFromISR((task), 0, (value), (action), nullptr, (woken))
+#define xTaskNotifyIndexedFromISR(task, index, value, action, woken) xTaskGenericNotifyFromISR((task), (index), (value), (action), nullptr, (woken))
+#define xTaskNotifyWait(clear_on_entry, clear_on_exit, value, wait) xTaskGenericNotifyWait(0, (clear_on_entry), (clear_on_exit), (value), (wait))
+#define xTaskNotifyWaitIndexed(index, clear_on_entry, clear_on_exit, value, wait) xTaskGenericNotifyWait((index), (clear_on_entry), (clear_on_exit), (value), (wait))
+#define xTaskNotifyGive(task) xTaskGenericNotify((task), 0, 0, eIncrement, nullptr)
+#define xTaskNotifyGiveIndexed(task, index) xTaskGenericNotify((task), (index), 0, eIncrement, nullptr)
+#define vTaskNotifyGiveFromISR(task, woken) vTaskGenericNotifyGiveFromISR((task), 0, (woken))
+#define ulTaskNotifyTake(clear_on_exit, wait) ulTaskGenericNotifyTake(0, (clear_on_exit), (wait))
+#define ulTaskNotifyTakeIndexed(index, clear_on_exit, wait) ulTaskGenericNotifyTake((index), (clear_on_exit), (wait))
@@ -0,0 +1,61 @@
+/// Host count of the kernel calls the motor task makes per move, the way Motor publishes its position
+/// now: the BeltPosition queue overwrites and the event group sets behind Notifier::Publish(), next to
+/// the ticks the move took, which is what an overwrite on every stepping tick would have cost.
+///
+///   cmake -S tools -B build-tools && cmake --build build-tools && build-tools/kernel_calls
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+
+#include <task.h>
+
+#include "host/Curtain.hpp"
+#include "host/Host.hpp"
+
+namespace {
+uint32_t Calls(const std::map<std::string, uint32_t>& calls, const char* function)
+{
+    const auto found = calls.find(function);
+    return found != calls.end() ? found->second : 0;
+}
+
+uint32_t Total(const std::map<std::string, uint32_t>& calls)
+{
+    uint32_t total = 0;
+    for (const auto& [function, count] : calls) {
+        total += count;
+    }
+    return total;
+}
+
+void Measure(const Curtain& curtain, const char* name, const Motor::Command command)
+{
+    TaskHandle_t motor = Host::FindTask(Curtain::BELT.name);
+    const std::map<std::string, uint32_t> before = Host::KernelCalls(motor);
+    const int from = curtain.GetMotor().GetPosition().steps;
+    const uint32_t ms = curtain.Execute(command);
+    const std::map<std::string, uint32_t> after = Host::KernelCalls(motor);
+    std::printf("%-12s %6d %7u | %10u %10u %8u\n", name, std::abs(curtain.GetMotor().GetPosition().steps - from), ms,
+        Calls(after, "xQueueOverwrite") - Calls(before, "xQueueOverwrite"),
+        Calls(after, "xEventGroupSetBits") - Calls(before, "xEventGroupSetBits"),
+        Total(after) - Total(before));
+}
+} // namespace
+
+int main()
+{
+    Host::EchoLog(false);
+    Curtain curtain;
+    // somebody has to listen for the notifier to set event group bits, like the HTTP server does
+    curtain.GetNotifier().Subscribe({ .name = "Observer", .topics = Notifier::ALL, .min_interval = 0, .max_latency = 0 });
+    curtain.Run([&] {
+        std::printf("%-12s %6s %7s | %10s %10s %8s\n", "move", "steps", "ticks", "overwrites", "bits set", "total");
+        curtain.Execute(Motor::CLOSE_COMPLETELY);
+        Measure(curtain, "full open", Motor::OPEN_COMPLETELY);
+        curtain.Execute(Motor::CLOSE_COMPLETELY);
+        Measure(curtain, "100 -> 50 %", Motor::Command { 50 });
+        Measure(curtain, "50 -> 45 %", Motor::Command { 45 });
+    });
+}
@@ -0,0 +1,68 @@
+/// Host simulation of MotionPlanner: time for a full 0 -> 100 % curtain travel and a few
+/// shorter moves, with the constant 2 ms step of the old motor task as the baseline.
+///
+///   g++ -std=c++17 -Isrc tools/motion_sim.cpp src/MotionPlanner.cpp -o motion_sim && ./motion_sim [belt steps]
+
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <iterator>
+
+#include "MotionPlanner.hpp"
+
+namespace {
+constexpr float CONSTANT_PERIOD_S = 0.002f;
+
+struct Result {
+    float seconds;
+    float peak_speed;
+    float end_speed; /// speed of the last segment
+    uint32_t creep_steps; /// steps at start speed after the deceleration
+    uint32_t segments;
+};
+
+Result Simulate(const MotionPlanner::Profile& profile, uint32_t steps)
+{
+    MotionPlanner planner;
+    planner.Begin(profile);
+    Result result = {};
+    bool decelerated = false;
+    float previous_speed = profile.start_speed;
+    while (steps != 0) {
+        const MotionPlanner::Segment segment = planner.Next(steps);
+        const float speed = 1'000'000.0f / static_cast<float>(segment.period_us);
+        steps -= segment.steps;
+        result.seconds += static_cast<float>(segment.steps * segment.period_us) / 1'000'000.0f;
+        result.peak_speed = speed > result.peak_speed ? speed : result.peak_speed;
+        result.end_speed = speed;
+        decelerated = decelerated || speed < previous_speed;
+        if (decelerated && segment.period_us >= static_cast<uint32_t>(1'000'000.0f / profile.start_speed)) {
+            result.creep_steps += segment.steps;
+        }
+        previous_speed = speed;
+        ++result.segments;
+    }
+    return result;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const uint32_t belt = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10'000;
+    // keep in sync with the profiles in main.cpp
+    const MotionPlanner::Profile profiles[] = {
+        { .start_speed = 500, .max_speed = 2'000, .acceleration = 2'000, .jerk = 0 },
+        { .start_speed = 500, .max_speed = 2'000, .acceleration = 2'000, .jerk = 20'000 },
+        { .start_speed = 500, .max_speed = 800, .acceleration = 1'000, .jerk = 0 },
+    };
+    const char* names[] = { "trapezoid", "s-curve", "calibration" };
+
+    std::printf("%-12s %8s %9s %9s %10s %10s %6s\n", "profile", "steps", "time s", "2 ms s", "peak st/s", "end st/s", "creep");
+    for (const uint32_t steps : { belt, belt / 2, belt / 10, belt / 100 }) {
+        for (size_t i = 0; i < std::size(profiles); ++i) {
+            const Result result = Simulate(profiles[i], steps);
+            std::printf("%-12s %8u %9.2f %9.2f %10.0f %10.0f %6u\n", names[i], steps, result.seconds,
+                static_cast<float>(steps) * CONSTANT_PERIOD_S, result.peak_speed, result.end_speed, result.creep_steps);
+        }
+    }
+}
@@ -0,0 +1,35 @@
+/// Host run of MotorBenchmark: the firmware's Motor, SimulatedBelt, PositionJournal and Storage on
+/// the host kernel, the same as a MOTOR_SIMULATION build but without a Pico. The log carries the
+/// benchmark's per-command time, position error and lost steps on simulated time.
+///
+///   cmake -S tools -B build-tools && cmake --build build-tools && build-tools/motor_bench [bounce edges]
+
+#include <cstdlib>
+
+#include <task.h>
+
+#include "MotorBenchmark.hpp"
+#include "host/Curtain.hpp"
+#include "host/Host.hpp"
+
+int main(int argc, char** argv)
+{
+    SimulatedBelt::Parameters belt = Curtain::BELT;
+    if (argc > 1) {
+        belt.bounce_edges = std::atoi(argv[1]);
+    }
+    Curtain curtain(belt);
+    new MotorBenchmark({
+        .task_name = "Benchmark",
+
+        .motor = &curtain.GetMotor(),
+        .belt = &curtain.GetBelt(),
+        .s_control_auto = &curtain.ControlAuto(),
+    });
+    curtain.Run([] {
+        while (Host::FindTask("Benchmark") != nullptr) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+    });
+    return 0;
+}
@@ -0,0 +1,63 @@
+/// Host check of Motor's move targets on the simulated belt: percentages, per-mille and raw steps,
+/// each also posted while another move is under way, must end exactly on Motor::TargetSteps() with
+/// the carriage agreeing. Exits non-zero on the first that does not.
+///
+///   cmake -S tools -B build-tools && cmake --build build-tools && build-tools/move_targets
+
+#include <cstdio>
+#include <iterator>
+
+#include <task.h>
+
+#include "host/Curtain.hpp"
+#include "host/Host.hpp"
+
+namespace {
+struct Move {
+    const char* name;
+    Motor::Command command;
+    /// Posted this long into the previous move instead of after it, 0 to wait for it
+    TickType_t preempt_after;
+};
+
+const Move MOVES[] = {
+    { "70 %", Motor::Command { 70 }, 0 },
+    { "45.5 %", Motor::Permille(455), 0 },
+    { "4321 steps", Motor::Steps(4321), 0 },
+    { "0.1 %", Motor::Permille(1), 0 },
+    { "99.9 %", Motor::Permille(999), 0 },
+    { "12 steps", Motor::Steps(12), 0 },
+    // turned around and cut short mid-move
+    { "90 %", Motor::Command { 90 }, 0 },
+    { "33.3 %", Motor::Permille(333), pdMS_TO_TICKS(700) },
+    { "8000 steps", Motor::Steps(8000), pdMS_TO_TICKS(300) },
+    { "50 %", Motor::Command { 50 }, pdMS_TO_TICKS(50) },
+};
+} // namespace
+
+int main()
+{
+    Host::EchoLog(false);
+    Curtain curtain;
+    int failures = 0;
+    curtain.Run([&] {
+        const Motor& motor = curtain.GetMotor();
+        for (size_t index = 0; index < std::size(MOVES); ++index) {
+            const Move& move = MOVES[index];
+            const bool preempted_next = index + 1 < std::size(MOVES) && MOVES[index + 1].preempt_after != 0;
+            if (preempted_next) {
+                curtain.GetMotor().Post(move.command, xTaskGetCurrentTaskHandle());
+                vTaskDelay(MOVES[index + 1].preempt_after);
+                continue;
+            }
+            curtain.Execute(move.command);
+            const Motor::Position position = motor.GetPosition();
+            const int expected = Motor::TargetSteps(move.command, position.max);
+            const bool ok = position.steps == expected && curtain.PositionError() == 0;
+            std::printf("%-12s expected %5d  motor %5d / %5d  error %3d  %s\n", move.name, expected, position.steps, position.max,
+                curtain.PositionError(), ok ? "ok" : "FAILED");
+            failures += ok ? 0 : 1;
+        }
+    });
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+/// Host benchmark of the tagged settings records in Flash: the CPU time to encode and append a
+/// record and to recover the settings from a full log at boot. It then damages one field of the
+/// newest record and checks that only that field falls back to the record before.
+///
+///   cmake -S tools -B build-tools && cmake --build build-tools && build-tools/settings_codec [records]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Flash.hpp"
+#include "host/Host.hpp"
+
+namespace {
+class SettingsStore final : public Flash {
+public:
+    using Flash::AccessSettings;
+    using Flash::Program;
+};
+
+constexpr ptrdiff_t SETTINGS_BOTTOM = PICO_FLASH_SIZE_BYTES * 3 / 4;
+constexpr uint32_t RECORD_MAGIC = 0x484C5453; // "STLH", see Flash::RECORD_MAGIC
+
+double MicrosecondsSince(const std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// Start of the record with 'sequence', or nullptr
+uint8_t* FindRecord(const uint32_t sequence)
+{
+    for (ptrdiff_t address = SETTINGS_BOTTOM; address < Flash::JOURNAL_BOTTOM; address += FLASH_PAGE_SIZE) {
+        uint8_t* record = host_flash + address;
+        uint32_t magic = 0;
+        uint32_t record_sequence = 0;
+        std::memcpy(&magic, record, sizeof(magic));
+        std::memcpy(&record_sequence, record + 8, sizeof(record_sequence)); // after magic, crc and length
+        if (magic == RECORD_MAGIC && record_sequence == sequence) {
+            return record;
+        }
+    }
+    return nullptr;
+}
+}
+
+int main(int argc, char** argv)
+{
+    const int records = argc > 1 ? std::atoi(argv[1]) : 1'000;
+    Host::EchoLog(false);
+    Host::EraseFlash();
+
+    auto* store = new SettingsStore();
+    double encode_us = 0;
+    for (int record = 1; record <= records; ++record) {
+        store->AccessSettings().channels[0].belt_position = static_cast<uint16_t>(record);
+        const auto start = std::chrono::steady_clock::now();
+        store->Program();
+        encode_us += MicrosecondsSince(start);
+    }
+    delete store;
+
+    static constexpr int BOOTS = 100;
+    double recover_us = 0;
+    for (int boot = 0; boot < BOOTS; ++boot) {
+        const auto start = std::chrono::steady_clock::now();
+        delete new SettingsStore();
+        recover_us += MicrosecondsSince(start);
+    }
+    std::printf("encode and append: %.2f us per record (%d records)\n", encode_us / records, records);
+    std::printf("recover at boot:   %.1f us over a log of %td sectors\n", recover_us / BOOTS, (Flash::JOURNAL_BOTTOM - SETTINGS_BOTTOM) / FLASH_SECTOR_SIZE);
+
+    // one more record that differs in the lux targets and the belt position, then a bit flipped in its lux targets
+    store = new SettingsStore();
+    const Flash::Settings previous = store->AccessSettings();
+    store->AccessSettings().lux_targets[Flash::H12] = 1234.0f;
+    store->AccessSettings().channels[0].belt_position = 4321;
+    store->Program();
+    const Flash::Settings newest = store->AccessSettings();
+    uint8_t* record = FindRecord(store->GetStatistics().sequence);
+    delete store;
+    uint8_t* lux_targets = record != nullptr
+        ? std::search(record, record + 4 * FLASH_PAGE_SIZE, reinterpret_cast<const uint8_t*>(newest.lux_targets), reinterpret_cast<const uint8_t*>(newest.lux_targets + 1))
+        : nullptr;
+    if (lux_targets == nullptr || lux_targets == record + 4 * FLASH_PAGE_SIZE) {
+        std::printf("damaged field: newest record not found\n");
+        return EXIT_FAILURE;
+    }
+    lux_targets[0] ^= 0x01;
+
+    store = new SettingsStore();
+    const Flash::Settings recovered = store->AccessSettings();
+    delete store;
+    const bool fell_back = std::memcmp(recovered.lux_targets, previous.lux_targets, sizeof(previous.lux_targets)) == 0;
+    const bool kept = recovered.channels[0].belt_position == newest.channels[0].belt_position;
+    std::printf("damaged field:     lux targets %s, belt position %s\n",
+        fell_back ? "from the record before" : "WRONG", kept ? "from the damaged record" : "WRONG");
+    return fell_back && kept ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+"""Host reference model of the PIO step generator.
+
+Runs src/StepGenerator.pio cycle by cycle on a stream of (steps, period_us)
+segments, encoded the same way as StepGenerator::Encode, and checks the
+resulting pulse train: step count, period of every step and the extra low
+time between segments. With --abort-at it also checks the step count that
+StepGenerator::Abort derives from the program counter and x.
+
+Example:
+    ./tools/step_generator_model.py 4:2000 4:2000 100:500 --abort-at 10000
+"""
+
+import argparse
+import pathlib
+import re
+import sys
+
+PIO_SOURCE = pathlib.Path(__file__).resolve().parent.parent / "src" / "StepGenerator.pio"
+
+# Keep in sync with StepGenerator.hpp
+SM_CLOCK_HZ = 1_000_000
+PERIOD_OVERHEAD_CYCLES = 5
+MIN_PERIOD_US = 20
+
+
+def encode(steps, period_us):
+    period = max(period_us, MIN_PERIOD_US) * (SM_CLOCK_HZ // 1_000_000)
+    return [steps - 1, (period - PERIOD_OVERHEAD_CYCLES) // 2]
+
+
+def assemble(path):
+    """Returns (instructions, labels) for the subset of PIO assembly the program uses"""
+    instructions = []
+    labels = {}
+    for line in path.read_text().splitlines():
+        line = line.split(";")[0].strip()
+        if not line or line.startswith("."):
+            continue
+        if line.endswith(":"):
+            labels[line.split()[-1][:-1]] = len(instructions)
+            continue
+        side = None
+        match = re.search(r"\bside\s+(\d)", line)
+        if match:
+            side = int(match.group(1))
+            line = line[: match.start()].strip()
+        instructions.append((line.replace(",", " ").split(), side))
+    return instructions, labels
+
+
+class StateMachine:
+    def __init__(self, instructions, labels):
+        self.instructions = instructions
+        self.labels = labels
+        self.pc = labels["start"]
+        self.x = self.y = self.osr = 0
+        self.tx = []
+        self.rx = []
+        self.pin = 0
+
+    def step(self):
+        """Executes one cycle; returns False while stalled"""
+        words, side = self.instructions[self.pc]
+        op = words[0]
+        next_pc = self.pc + 1
+        if op == "pull":
+            if not self.tx:
+                return False
+            self.osr = self.tx.pop(0)
+        elif op == "out":
+            self.x = self.osr
+        elif op == "mov":
+            self.y = self.osr
+        elif op == "jmp":
+            register = words[1][0]
+            value = getattr(self, register)
+            setattr(self, register, (value - 1) & 0xFFFFFFFF)
+            if value != 0:
+                next_pc = self.labels[words[2]]
+        elif op == "push":
+            if len(self.rx) == 4:
+                return False
+            self.rx.append(0)
+        else:
+            raise ValueError(f"unsupported instruction {words}")
+        if side is not None:
+            self.pin = side
+        self.pc = next_pc % len(self.instructions)
+        return True
+
+    def abort_steps(self, segment_steps):
+        """Steps of the oldest segment taken so far, the way StepGenerator::Abort counts them"""
+        if self.pc == self.labels["done"]:
+            return segment_steps
+        if self.pc < self.labels["step"]:
+            return 0
+        remaining = self.x + (1 if self.pc == self.labels["step"] else 0)
+        return segment_steps - remaining if remaining < segment_steps else 0
+
+
+def parse_segment(text):
+    steps, period = text.split(":")
+    return int(steps), int(period)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("segments", nargs="+", type=parse_segment, help="steps:period_us")
+    parser.add_argument("--abort-at", type=int, help="cycle at which to check Abort() accounting")
+    args = parser.parse_args()
+
+    sm = StateMachine(*assemble(PIO_SOURCE))
+    for steps, period in args.segments:
+        sm.tx.extend(encode(steps, period))
+
+    rises = []
+    completed = 0
+    cycle = 0
+    failures = 0
+    while True:
+        previous = sm.pin
+        sm.step()
+        if sm.pin and not previous:
+            rises.append(cycle)
+        if len(sm.rx) > completed:
+            completed = len(sm.rx)
+        cycle += 1
+        if args.abort_at is not None and cycle == args.abort_at:
+            taken = sum(steps for steps, _ in args.segments[:completed])
+            if completed < len(args.segments):
+                taken += sm.abort_steps(args.segments[completed][0])
+            status = "ok" if taken == len(rises) else "MISMATCH"
+            failures += taken != len(rises)
+            print(f"abort at cycle {cycle}: Abort() counts {taken} steps, {len(rises)} pulses started, {status}")
+            break
+        if completed == len(args.segments):
+            break
+
+    expected = sum(steps for steps, _ in args.segments)
+    if args.abort_at is None:
+        print(f"{len(rises)} pulses for {expected} steps, {cycle} cycles ({cycle / SM_CLOCK_HZ * 1e3:.3f} ms)")
+        failures += len(rises) != expected
+        index = 0
+        for number, (steps, period) in enumerate(args.segments):
+            wanted = max(period, MIN_PERIOD_US)
+            wanted -= (wanted - PERIOD_OVERHEAD_CYCLES) % 2
+            intervals = [rises[i + 1] - rises[i] for i in range(index, min(index + steps, len(rises) - 1))]
+            within = intervals[: steps - 1]
+            gap = intervals[steps - 1] - wanted if len(intervals) >= steps else None
+            bad = [interval for interval in within if interval != wanted]
+            failures += len(bad)
+            print(f"segment {number}: {steps} x {wanted} cycles, {len(bad)} off-period steps"
+                  + (f", +{gap} cycles before the next segment" if gap is not None else ""))
+            index += steps
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()